@@ -2,10 +2,10 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
-// Attributes
-layout (location = 0) in vec3 in_Position;
-layout (location = 1) in vec3 in_Normal;
-layout (location = 2) in vec4 in_Color;
+// Attributes, float or quantized (StaticModelRenderer::setCompression)
+layout (location = 0) in vec4 in_Position; // unorm16 relative to the mesh bounds
+layout (location = 1) in vec4 in_Normal;   // octahedral snorm16 in xy
+layout (location = 2) in vec4 in_Color;    // unorm8
 //layout (location = 3) in vec2 in_TexCoords;
 
 layout (binding = 0) uniform UBO { 
@@ -14,6 +14,13 @@ layout (binding = 0) uniform UBO {
     mat4 proj;
 } ubo;
 
+layout (push_constant) uniform Bounds {
+    vec4 min;
+    vec4 extent;
+} bounds;
+
+layout (constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
+
 out gl_PerVertex 
 {
     vec4 gl_Position;
@@ -22,10 +29,23 @@ out gl_PerVertex
 layout (location = 0) out vec4 v_Color;
 //layout (location = 1) out vec2 v_TexCoords;
 
+vec3 octahedralDecode(vec2 p)
+{
+    vec3 v = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (v.z < 0.0)
+    {
+        v.xy = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
 void main()
 {
+    vec3 normal = OCTAHEDRAL_NORMALS ? octahedralDecode(in_Normal.xy) : in_Normal.xyz;
+    vec3 position = bounds.min.xyz + in_Position.xyz * bounds.extent.xyz;
+
     //v_TexCoords = in_TexCoords;
-    v_Color = vec4(abs(in_Normal.r), abs(in_Normal.g), abs(in_Normal.b), 1.0);
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(in_Position, 1.0);
+    v_Color = vec4(abs(normal.r), abs(normal.g), abs(normal.b), 1.0);
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
     gl_Position.y = -gl_Position.y;
 }
\ No newline at end of file
@@ -0,0 +1,778 @@
+#include "triangle_bvh.h"
+#include "../util/parallel.h"
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <assert.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define BVH_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace bvh
+{
+
+namespace
+{
+
+// ranges at least this large are binned and bounded with several workers, and their two halves are built concurrently
+const size_t PARALLEL_TRIANGLES = 16384;
+
+struct Bin
+{
+	glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+	uint32_t count = 0;
+
+	void grow(const glm::vec3& p)
+	{
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+
+	void grow(const Bin& other)
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+		count += other.count;
+	}
+};
+
+float halfArea(const glm::vec3& min, const glm::vec3& max)
+{
+	const glm::vec3 e = max - min;
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+uint32_t binOf(const glm::vec3& centroid, int axis, const glm::vec3& centroid_min, const glm::vec3& centroid_scale, size_t bin_count)
+{
+	const float b = (centroid[axis] - centroid_min[axis]) * centroid_scale[axis];
+	return std::min((uint32_t)std::max(b, 0.0f), (uint32_t)bin_count - 1);
+}
+
+} // end anonymous namespace
+
+TriangleBvh::TriangleBvh(size_t max_leaf_triangles, size_t bin_count)
+	: d_max_leaf_triangles(std::max<size_t>(1, max_leaf_triangles))
+	, d_bin_count(std::max<size_t>(2, bin_count))
+{
+}
+
+TriangleBvh::~TriangleBvh()
+{
+	clear();
+}
+
+void TriangleBvh::build(const mesh::BasicMesh& mesh)
+{
+	clear();
+
+	const size_t count = mesh.indices.size() / 3;
+	if (count == 0)
+	{
+		return;
+	}
+
+	d_corners.resize(count * 3);
+	d_centroids.resize(count);
+	d_triangles.resize(count);
+
+	util::Parallel::forEach(count, [&](size_t i) {
+		for (size_t k = 0; k < 3; ++k)
+		{
+			d_corners[i * 3 + k] = mesh.positions[mesh.indices[i * 3 + k]];
+		}
+		d_centroids[i] = (d_corners[i * 3] + d_corners[i * 3 + 1] + d_corners[i * 3 + 2]) * (1.0f / 3.0f);
+		d_triangles[i] = (uint32_t)i;
+	});
+
+	// a binary tree with at least one triangle per leaf has at most 2n - 1 nodes
+	d_nodes.resize(count * 2 - 1);
+	d_node_count = 1;
+
+	BvhNode& root = d_nodes[0];
+	root.leftFirst = 0;
+	root.count = (uint32_t)count;
+	updateBounds(root);
+	subdivide(0, 0);
+
+	d_nodes.resize(d_node_count);
+	d_nodes.shrink_to_fit();
+	std::vector<Point>().swap(d_centroids);
+}
+
+void TriangleBvh::refit(const mesh::BasicMesh& mesh)
+{
+	const size_t count = mesh.indices.size() / 3;
+	assert(count == d_triangles.size());
+
+	if (d_nodes.empty() || count != d_triangles.size())
+	{
+		return;
+	}
+
+	util::Parallel::forEach(count, [&](size_t i) {
+		for (size_t k = 0; k < 3; ++k)
+		{
+			d_corners[i * 3 + k] = mesh.positions[mesh.indices[i * 3 + k]];
+		}
+	});
+
+	// leaves in parallel, then interior nodes back to front since children follow their parent
+	util::Parallel::forEach(d_nodes.size(), [&](size_t i) {
+		if (d_nodes[i].count)
+		{
+			updateBounds(d_nodes[i]);
+		}
+	});
+
+	for (size_t i = d_nodes.size(); i-- > 0;)
+	{
+		BvhNode& node = d_nodes[i];
+		if (node.count == 0)
+		{
+			const BvhNode& left = d_nodes[node.leftFirst];
+			const BvhNode& right = d_nodes[node.leftFirst + 1];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+	}
+}
+
+void TriangleBvh::clear()
+{
+	d_nodes.clear();
+	d_node_count = 0;
+	d_triangles.clear();
+	d_corners.clear();
+	d_centroids.clear();
+}
+
+bool TriangleBvh::traverse(Callback callback)
+{
+	assert(callback);
+	return traverse<Callback&>(callback);
+}
+
+bool TriangleBvh::cullFrustum(const camera::FreeCamera& camera, std::vector<std::span<uint32_t>>& visible_leaves)
+{
+	visible_leaves.clear();
+
+	if (d_nodes.empty())
+	{
+		return false;
+	}
+
+	const camera::Frustum frustum(camera.planes());
+
+	uint32_t stack[MAX_DEPTH + 1];
+	size_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const uint32_t index = stack[--top];
+		const BvhNode& node = d_nodes[index];
+		const camera::Visibility visibility = frustum.classify(node.min, node.max);
+
+		if (visibility == camera::VISIBILITY_OUTSIDE)
+		{
+			continue;
+		}
+
+		if (visibility == camera::VISIBILITY_INSIDE || node.count)
+		{
+			collect(index, visible_leaves);
+			continue;
+		}
+
+		stack[top++] = node.leftFirst + 1;
+		stack[top++] = node.leftFirst;
+	}
+
+	return true;
+}
+
+bool TriangleBvh::raycast(const Point& origin, const Point& dir, float max_t, RayCallback callback, float& hit_t)
+{
+	assert(callback);
+
+	if (d_nodes.empty())
+	{
+		return false;
+	}
+
+	// zero components become huge slopes instead of inf * 0 = nan in the slab test
+	Point inv_dir;
+	for (int i = 0; i < 3; ++i)
+	{
+		const float d = std::abs(dir[i]) < 1e-20f ? std::copysign(1e-20f, dir[i]) : dir[i];
+		inv_dir[i] = 1.0f / d;
+	}
+
+	float best_t = max_t;
+	float t_enter;
+	if (!intersect_ray(d_nodes[0], origin, inv_dir, best_t, t_enter))
+	{
+		return false;
+	}
+
+	bool hit = false;
+	uint32_t stack[MAX_DEPTH + 1];
+	size_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const BvhNode& node = d_nodes[stack[--top]];
+
+		if (node.count)
+		{
+			hit |= callback(std::span<uint32_t>(d_triangles.data() + node.leftFirst, node.count), best_t);
+			continue;
+		}
+
+		// nearer child is popped first, children entered beyond the best hit are dropped
+		float t_left, t_right;
+		const bool left = intersect_ray(d_nodes[node.leftFirst], origin, inv_dir, best_t, t_left);
+		const bool right = intersect_ray(d_nodes[node.leftFirst + 1], origin, inv_dir, best_t, t_right);
+
+		if (left && right)
+		{
+			const bool left_first = t_left <= t_right;
+			stack[top++] = left_first ? node.leftFirst + 1 : node.leftFirst;
+			stack[top++] = left_first ? node.leftFirst : node.leftFirst + 1;
+		}
+		else if (left)
+		{
+			stack[top++] = node.leftFirst;
+		}
+		else if (right)
+		{
+			stack[top++] = node.leftFirst + 1;
+		}
+	}
+
+	if (hit)
+	{
+		hit_t = best_t;
+	}
+	return hit;
+}
+
+bool TriangleBvh::raycast(const Point& origin, const Point& dir, float max_t, Hit& hit)
+{
+	Hit best;
+	float hit_t;
+
+	const bool found = raycast(origin, dir, max_t, [&](std::span<uint32_t> triangles, float& t) {
+		bool any = false;
+		for (auto id : triangles)
+		{
+			if (intersect_triangle(id, origin, dir, t, best))
+			{
+				t = best.t;
+				any = true;
+			}
+		}
+		return any;
+	}, hit_t);
+
+	if (found)
+	{
+		hit = best;
+	}
+	return found;
+}
+
+void TriangleBvh::overlap(const Point& min, const Point& max, std::vector<uint32_t>& triangles)
+{
+	triangles.clear();
+
+	if (d_nodes.empty())
+	{
+		return;
+	}
+
+#if defined(BVH_SSE)
+	const __m128 query_min = _mm_set_ps(0.0f, min.z, min.y, min.x);
+	const __m128 query_max = _mm_set_ps(0.0f, max.z, max.y, max.x);
+#endif
+
+	uint32_t stack[MAX_DEPTH + 1];
+	size_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const BvhNode& node = d_nodes[stack[--top]];
+
+#if defined(BVH_SSE)
+		// the fourth lane holds leftFirst / count bits and is masked out
+		const __m128 node_min = _mm_loadu_ps(&node.min.x);
+		const __m128 node_max = _mm_loadu_ps(&node.max.x);
+		const int separated = _mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(query_min, node_max), _mm_cmpgt_ps(node_min, query_max))) & 7;
+#else
+		const int separated =
+			(min.x > node.max.x || node.min.x > max.x ||
+			min.y > node.max.y || node.min.y > max.y ||
+			min.z > node.max.z || node.min.z > max.z) ? 1 : 0;
+#endif
+
+		if (separated)
+		{
+			continue;
+		}
+
+		if (node.count)
+		{
+			// leaf boxes are loose around single triangles, test each one
+			for (uint32_t i = 0; i < node.count; ++i)
+			{
+				const uint32_t id = d_triangles[node.leftFirst + i];
+				const Point& a = d_corners[id * 3];
+				const Point& b = d_corners[id * 3 + 1];
+				const Point& c = d_corners[id * 3 + 2];
+				const Point tri_min = glm::min(glm::min(a, b), c);
+				const Point tri_max = glm::max(glm::max(a, b), c);
+
+				if (tri_min.x <= max.x && tri_max.x >= min.x &&
+					tri_min.y <= max.y && tri_max.y >= min.y &&
+					tri_min.z <= max.z && tri_max.z >= min.z)
+				{
+					triangles.push_back(id);
+				}
+			}
+			continue;
+		}
+
+		stack[top++] = node.leftFirst + 1;
+		stack[top++] = node.leftFirst;
+	}
+}
+
+void TriangleBvh::knn(const Point& p, size_t k, const PositionFn& position_of, std::vector<Neighbor>& out)
+{
+	assert(position_of);
+	out.clear();
+
+	if (d_nodes.empty() || k == 0)
+	{
+		return;
+	}
+
+	struct Entry
+	{
+		float distance2;
+		uint32_t node;
+		bool operator<(const Entry& other) const { return distance2 > other.distance2; } // min heap
+	};
+
+	auto farther = [](const Neighbor& a, const Neighbor& b) { return a.distance2 < b.distance2; };
+
+	// nodes ordered by box distance, results kept as a max heap bounded to k
+	std::priority_queue<Entry> nodes;
+	nodes.push({ distance2_to_box(p, d_nodes[0].min, d_nodes[0].max), 0 });
+	out.reserve(k);
+
+	while (!nodes.empty())
+	{
+		const Entry entry = nodes.top();
+		nodes.pop();
+
+		if (out.size() == k && entry.distance2 >= out.front().distance2)
+		{
+			break; // no remaining node can hold a closer triangle
+		}
+
+		const BvhNode& node = d_nodes[entry.node];
+
+		if (node.count)
+		{
+			for (uint32_t i = 0; i < node.count; ++i)
+			{
+				uint32_t& id = d_triangles[node.leftFirst + i];
+				const Point delta = position_of(id) - p;
+				const float d2 = glm::dot(delta, delta);
+
+				if (out.size() < k)
+				{
+					out.push_back({ &id, d2 });
+					std::push_heap(out.begin(), out.end(), farther);
+				}
+				else if (d2 < out.front().distance2)
+				{
+					std::pop_heap(out.begin(), out.end(), farther);
+					out.back() = { &id, d2 };
+					std::push_heap(out.begin(), out.end(), farther);
+				}
+			}
+			continue;
+		}
+
+		for (uint32_t child = node.leftFirst; child < node.leftFirst + 2; ++child)
+		{
+			const float d2 = distance2_to_box(p, d_nodes[child].min, d_nodes[child].max);
+
+			if (out.size() < k || d2 < out.front().distance2)
+			{
+				nodes.push({ d2, child });
+			}
+		}
+	}
+
+	std::sort_heap(out.begin(), out.end(), farther);
+}
+
+void TriangleBvh::radius(const Point& p, float r, const PositionFn& position_of, std::vector<Neighbor>& out)
+{
+	assert(position_of);
+	out.clear();
+
+	const float r2 = r * r;
+	if (d_nodes.empty() || distance2_to_box(p, d_nodes[0].min, d_nodes[0].max) > r2)
+	{
+		return;
+	}
+
+	uint32_t stack[MAX_DEPTH + 1];
+	size_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const BvhNode& node = d_nodes[stack[--top]];
+
+		if (node.count)
+		{
+			for (uint32_t i = 0; i < node.count; ++i)
+			{
+				uint32_t& id = d_triangles[node.leftFirst + i];
+				const Point delta = position_of(id) - p;
+				const float d2 = glm::dot(delta, delta);
+
+				if (d2 <= r2)
+				{
+					out.push_back({ &id, d2 });
+				}
+			}
+			continue;
+		}
+
+		for (uint32_t child = node.leftFirst; child < node.leftFirst + 2; ++child)
+		{
+			if (distance2_to_box(p, d_nodes[child].min, d_nodes[child].max) <= r2)
+			{
+				stack[top++] = child;
+			}
+		}
+	}
+}
+
+void TriangleBvh::knn(std::span<const Point> queries, size_t k, const PositionFn& position_of, std::vector<std::vector<Neighbor>>& results)
+{
+	results.resize(queries.size());
+	util::Parallel::forEach(queries.size(), [&](size_t i) {
+		knn(queries[i], k, position_of, results[i]);
+	}, 64);
+}
+
+void TriangleBvh::radius(std::span<const Point> queries, float r, const PositionFn& position_of, std::vector<std::vector<Neighbor>>& results)
+{
+	results.resize(queries.size());
+	util::Parallel::forEach(queries.size(), [&](size_t i) {
+		radius(queries[i], r, position_of, results[i]);
+	}, 64);
+}
+
+const std::vector<BvhNode>& TriangleBvh::nodes() const
+{
+	return d_nodes;
+}
+
+size_t TriangleBvh::triangle_count() const
+{
+	return d_triangles.size();
+}
+
+void TriangleBvh::triangle(uint32_t id, Point& a, Point& b, Point& c) const
+{
+	assert(id < d_triangles.size());
+	a = d_corners[id * 3];
+	b = d_corners[id * 3 + 1];
+	c = d_corners[id * 3 + 2];
+}
+
+void TriangleBvh::subdivide(uint32_t node_index, uint32_t depth)
+{
+	BvhNode& node = d_nodes[node_index];
+
+	if (node.count <= d_max_leaf_triangles || depth + 1 >= MAX_DEPTH)
+	{
+		return;
+	}
+
+	int axis;
+	uint32_t split_bin;
+	Point centroid_min, centroid_scale;
+	if (!findSplit(node, axis, split_bin, centroid_min, centroid_scale))
+	{
+		return; // a leaf is cheaper than any split
+	}
+
+	uint32_t* first = d_triangles.data() + node.leftFirst;
+	uint32_t* middle = std::partition(first, first + node.count, [&](uint32_t id) {
+		return binOf(d_centroids[id], axis, centroid_min, centroid_scale, d_bin_count) <= split_bin;
+	});
+
+	const uint32_t left_count = (uint32_t)(middle - first);
+	if (left_count == 0 || left_count == node.count)
+	{
+		return;
+	}
+
+	// the node array never reallocates during a build, so siblings can be claimed from several threads
+	const uint32_t left = d_node_count.fetch_add(2);
+	d_nodes[left].leftFirst = node.leftFirst;
+	d_nodes[left].count = left_count;
+	d_nodes[left + 1].leftFirst = node.leftFirst + left_count;
+	d_nodes[left + 1].count = node.count - left_count;
+
+	const bool parallel = node.count >= PARALLEL_TRIANGLES;
+	node.leftFirst = left;
+	node.count = 0;
+
+	if (parallel)
+	{
+		util::Parallel::forEachChunk(2, 2, [&](size_t child, size_t, size_t) {
+			updateBounds(d_nodes[left + child]);
+			subdivide(left + (uint32_t)child, depth + 1);
+		});
+	}
+	else
+	{
+		updateBounds(d_nodes[left]);
+		updateBounds(d_nodes[left + 1]);
+		subdivide(left, depth + 1);
+		subdivide(left + 1, depth + 1);
+	}
+}
+
+bool TriangleBvh::findSplit(const BvhNode& node, int& axis, uint32_t& split_bin, Point& centroid_min, Point& centroid_scale)
+{
+	const uint32_t* ids = d_triangles.data() + node.leftFirst;
+	const size_t count = node.count;
+	const size_t chunks = count >= PARALLEL_TRIANGLES ? util::Parallel::chunkCount(count) : 1;
+
+	// 1. centroid bounds, the bins span them
+	std::vector<Bin> centroid_bounds(chunks);
+	util::Parallel::forEachChunk(count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			centroid_bounds[chunk].grow(d_centroids[ids[i]]);
+		}
+	});
+
+	for (size_t chunk = 1; chunk < chunks; ++chunk)
+	{
+		centroid_bounds[0].grow(centroid_bounds[chunk]);
+	}
+
+	centroid_min = centroid_bounds[0].min;
+	const Point extent = centroid_bounds[0].max - centroid_min;
+	for (int a = 0; a < 3; ++a)
+	{
+		centroid_scale[a] = extent[a] > 0.0f ? (float)d_bin_count / extent[a] : 0.0f;
+	}
+
+	// 2. triangle bounds and counts per bin and axis, one set of bins per chunk
+	const size_t bins_per_chunk = 3 * d_bin_count;
+	std::vector<Bin> bins(chunks * bins_per_chunk);
+
+	util::Parallel::forEachChunk(count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+		Bin* chunk_bins = &bins[chunk * bins_per_chunk];
+		for (size_t i = begin; i < end; ++i)
+		{
+			const uint32_t id = ids[i];
+			for (int a = 0; a < 3; ++a)
+			{
+				Bin& bin = chunk_bins[a * d_bin_count + binOf(d_centroids[id], a, centroid_min, centroid_scale, d_bin_count)];
+				++bin.count;
+				bin.grow(d_corners[id * 3]);
+				bin.grow(d_corners[id * 3 + 1]);
+				bin.grow(d_corners[id * 3 + 2]);
+			}
+		}
+	});
+
+	for (size_t chunk = 1; chunk < chunks; ++chunk)
+	{
+		for (size_t b = 0; b < bins_per_chunk; ++b)
+		{
+			bins[b].grow(bins[chunk * bins_per_chunk + b]);
+		}
+	}
+
+	// 3. sweep the planes between bins, SAH cost = left count * left area + right count * right area
+	float best_cost = (float)count * halfArea(node.min, node.max);
+	bool found = false;
+
+	std::vector<float> left_cost(d_bin_count);
+	for (int a = 0; a < 3; ++a)
+	{
+		if (centroid_scale[a] == 0.0f)
+		{
+			continue;
+		}
+
+		const Bin* axis_bins = &bins[a * d_bin_count];
+
+		Bin left;
+		for (size_t b = 0; b + 1 < d_bin_count; ++b)
+		{
+			left.grow(axis_bins[b]);
+			left_cost[b] = left.count ? (float)left.count * halfArea(left.min, left.max) : 0.0f;
+		}
+
+		Bin right;
+		for (size_t b = d_bin_count - 1; b > 0; --b)
+		{
+			right.grow(axis_bins[b]);
+			const float cost = left_cost[b - 1] + (right.count ? (float)right.count * halfArea(right.min, right.max) : 0.0f);
+
+			if (cost < best_cost && right.count && right.count < count)
+			{
+				best_cost = cost;
+				axis = a;
+				split_bin = (uint32_t)(b - 1);
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+void TriangleBvh::updateBounds(BvhNode& node)
+{
+	const uint32_t* ids = d_triangles.data() + node.leftFirst;
+	const size_t count = node.count;
+	const size_t chunks = count >= PARALLEL_TRIANGLES ? util::Parallel::chunkCount(count) : 1;
+
+	std::vector<Bin> bounds(chunks);
+	util::Parallel::forEachChunk(count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			const uint32_t id = ids[i];
+			bounds[chunk].grow(d_corners[id * 3]);
+			bounds[chunk].grow(d_corners[id * 3 + 1]);
+			bounds[chunk].grow(d_corners[id * 3 + 2]);
+		}
+	});
+
+	for (size_t chunk = 1; chunk < chunks; ++chunk)
+	{
+		bounds[0].grow(bounds[chunk]);
+	}
+
+	node.min = bounds[0].min;
+	node.max = bounds[0].max;
+}
+
+void TriangleBvh::collect(uint32_t node_index, std::vector<std::span<uint32_t>>& out)
+{
+	const BvhNode& node = d_nodes[node_index];
+
+	if (node.count)
+	{
+		out.push_back(std::span<uint32_t>(d_triangles.data() + node.leftFirst, node.count));
+		return;
+	}
+
+	collect(node.leftFirst, out);
+	collect(node.leftFirst + 1, out);
+}
+
+bool TriangleBvh::intersect_ray(const BvhNode& node, const Point& origin, const Point& inv_dir, float max_t, float& t_enter) const
+{
+#if defined(BVH_SSE)
+	// slab test on x, y, z at once, the fourth lane (leftFirst / count bits) is replaced by lane 0 before reducing
+	const __m128 o = _mm_set_ps(0.0f, origin.z, origin.y, origin.x);
+	const __m128 inv = _mm_set_ps(0.0f, inv_dir.z, inv_dir.y, inv_dir.x);
+	const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.min.x), o), inv);
+	const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.max.x), o), inv);
+
+	__m128 t_near = _mm_min_ps(t0, t1);
+	__m128 t_far = _mm_max_ps(t0, t1);
+	t_near = _mm_shuffle_ps(t_near, t_near, _MM_SHUFFLE(0, 2, 1, 0));
+	t_far = _mm_shuffle_ps(t_far, t_far, _MM_SHUFFLE(0, 2, 1, 0));
+
+	t_near = _mm_max_ps(t_near, _mm_shuffle_ps(t_near, t_near, _MM_SHUFFLE(1, 0, 3, 2)));
+	t_near = _mm_max_ps(t_near, _mm_shuffle_ps(t_near, t_near, _MM_SHUFFLE(2, 3, 0, 1)));
+	t_far = _mm_min_ps(t_far, _mm_shuffle_ps(t_far, t_far, _MM_SHUFFLE(1, 0, 3, 2)));
+	t_far = _mm_min_ps(t_far, _mm_shuffle_ps(t_far, t_far, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	t_enter = std::max(_mm_cvtss_f32(t_near), 0.0f);
+	const float t_exit = std::min(_mm_cvtss_f32(t_far), max_t);
+#else
+	const Point t0 = (node.min - origin) * inv_dir;
+	const Point t1 = (node.max - origin) * inv_dir;
+	const Point t_near = glm::min(t0, t1);
+	const Point t_far = glm::max(t0, t1);
+
+	t_enter = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+	const float t_exit = std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, max_t));
+#endif
+	return t_enter <= t_exit;
+}
+
+bool TriangleBvh::intersect_triangle(uint32_t id, const Point& origin, const Point& dir, float max_t, Hit& hit) const
+{
+	// Moller Trumbore, both faces
+	const Point& a = d_corners[id * 3];
+	const Point edge1 = d_corners[id * 3 + 1] - a;
+	const Point edge2 = d_corners[id * 3 + 2] - a;
+
+	const Point p = glm::cross(dir, edge2);
+	const float det = glm::dot(edge1, p);
+	if (std::abs(det) < 1e-12f)
+	{
+		return false;
+	}
+
+	const float inv_det = 1.0f / det;
+	const Point s = origin - a;
+	const float u = glm::dot(s, p) * inv_det;
+	if (u < 0.0f || u > 1.0f)
+	{
+		return false;
+	}
+
+	const Point q = glm::cross(s, edge1);
+	const float v = glm::dot(dir, q) * inv_det;
+	if (v < 0.0f || u + v > 1.0f)
+	{
+		return false;
+	}
+
+	const float t = glm::dot(edge2, q) * inv_det;
+	if (t < 0.0f || t >= max_t)
+	{
+		return false;
+	}
+
+	hit.triangle = id;
+	hit.t = t;
+	hit.u = u;
+	hit.v = v;
+	return true;
+}
+
+float TriangleBvh::distance2_to_box(const Point& p, const Point& min, const Point& max) const
+{
+	const Point delta = glm::max(glm::max(min - p, Point(0.0f)), p - max);
+	return glm::dot(delta, delta);
+}
+
+} // end namespace bvh
@@ -0,0 +1,152 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <atomic>
+#include <functional>
+#include <glm/glm.hpp>
+#include "../mesh/basic_mesh.h"
+#include "../camera/frustum.h"
+#include "../octree/spatial_query.h"
+#include "../camera/free_camera.h"
+
+namespace bvh
+{
+
+// 32 bytes, two per cache line. interior nodes have count == 0 and their children at
+// leftFirst and leftFirst + 1, leaves own count triangle ids starting at leftFirst.
+// children are always stored after their parent.
+struct BvhNode
+{
+	glm::vec3 min;
+	uint32_t  leftFirst = 0;
+	glm::vec3 max;
+	uint32_t  count = 0;
+};
+
+// binned SAH bounding volume hierarchy over the triangles of a BasicMesh.
+// satisfies octree::SpatialQuery with triangle ids (index / 3) as elements,
+// so callers written against the octree queries can swap to the other.
+class TriangleBvh
+{
+public:
+	using Point = glm::vec3;
+	using Element = uint32_t;
+	// deeper ranges stay leaves, so fixed size stacks cover every query
+	static constexpr uint32_t MAX_DEPTH = 64;
+	using Callback = std::function<bool(const Point& min, const Point& max, std::span<uint32_t> data)>;
+	// per leaf hit test, t holds the closest hit so far. lowers t and returns true when a triangle is hit before it.
+	using RayCallback = std::function<bool(std::span<uint32_t> triangles, float& t)>;
+	// position of a triangle for the proximity queries, e.g. its centroid. it must lie inside the bounds of the
+	// triangle, nodes are pruned by box distance. must be safe to call from several threads for the batched forms.
+	using PositionFn = std::function<Point(const uint32_t&)>;
+
+	struct Neighbor
+	{
+		uint32_t* element;
+		float distance2;
+	};
+
+	struct Hit
+	{
+		uint32_t triangle = 0;
+		float t = 0.0f;
+		float u = 0.0f; // barycentrics of the hit, weight of the second and third corner
+		float v = 0.0f;
+	};
+
+	TriangleBvh(size_t max_leaf_triangles = 4, size_t bin_count = 16);
+	~TriangleBvh();
+
+	TriangleBvh(const TriangleBvh&) = delete;
+	TriangleBvh(TriangleBvh&&) = delete;
+	void operator=(const TriangleBvh&) = delete;
+	void operator=(TriangleBvh&&) = delete;
+
+	// MEMBERS
+	// replaces the hierarchy, the triangle corners are copied so the mesh may go away afterwards
+	void build(const mesh::BasicMesh& mesh);
+	// recomputes every box for new vertex positions of the mesh the tree was built from, the topology is kept.
+	// much cheaper than build, trees degrade when the deformation moves triangles far from their neighbours.
+	void refit(const mesh::BasicMesh& mesh);
+	void clear();
+
+	bool traverse(Callback callback);
+	// pre-order walk, visitor(min, max, std::span<uint32_t>) -> bool, false skips the children
+	template <class Visitor>
+	bool traverse(Visitor&& visitor);
+	bool cullFrustum(const camera::FreeCamera& camera, std::vector<std::span<uint32_t>>& visible_leaves);
+	bool raycast(const Point& origin, const Point& dir, float max_t, RayCallback callback, float& hit_t);
+	// closest triangle along the ray, tested against the copied corners
+	bool raycast(const Point& origin, const Point& dir, float max_t, Hit& hit);
+	// every triangle whose bounds overlap the box
+	void overlap(const Point& min, const Point& max, std::vector<uint32_t>& triangles);
+	// the k triangles closest to p, nearest first. nodes are expanded best first and pruned by their box distance.
+	void knn(const Point& p, size_t k, const PositionFn& position_of, std::vector<Neighbor>& out);
+	// every triangle within r of p, in no particular order
+	void radius(const Point& p, float r, const PositionFn& position_of, std::vector<Neighbor>& out);
+	// one query per point, spread over worker threads. results[i] answers queries[i].
+	void knn(std::span<const Point> queries, size_t k, const PositionFn& position_of, std::vector<std::vector<Neighbor>>& results);
+	void radius(std::span<const Point> queries, float r, const PositionFn& position_of, std::vector<std::vector<Neighbor>>& results);
+
+	// ACCESSORS
+	const std::vector<BvhNode>& nodes() const;
+	size_t triangle_count() const;
+	void triangle(uint32_t id, Point& a, Point& b, Point& c) const;
+
+private:
+	size_t d_max_leaf_triangles;
+	size_t d_bin_count;
+	std::vector<BvhNode> d_nodes;
+	std::atomic<uint32_t> d_node_count = 0;
+	std::vector<uint32_t> d_triangles; // triangle ids in leaf order
+	std::vector<Point> d_corners;      // three per triangle id
+	std::vector<Point> d_centroids;
+
+	// HELPERS
+	void subdivide(uint32_t node_index, uint32_t depth);
+	bool findSplit(const BvhNode& node, int& axis, uint32_t& split_bin, Point& centroid_min, Point& centroid_scale);
+	void updateBounds(BvhNode& node);
+	void collect(uint32_t node_index, std::vector<std::span<uint32_t>>& out);
+	bool intersect_ray(const BvhNode& node, const Point& origin, const Point& inv_dir, float max_t, float& t_enter) const;
+	bool intersect_triangle(uint32_t id, const Point& origin, const Point& dir, float max_t, Hit& hit) const;
+	float distance2_to_box(const Point& p, const Point& min, const Point& max) const;
+};
+
+template <class Visitor>
+inline bool TriangleBvh::traverse(Visitor&& visitor)
+{
+	if (d_nodes.empty())
+	{
+		return false;
+	}
+
+	// depth first with an explicit stack, left child popped first
+	uint32_t stack[MAX_DEPTH + 1];
+	size_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const BvhNode& node = d_nodes[stack[--top]];
+
+		std::span<uint32_t> data;
+		if (node.count)
+		{
+			data = std::span<uint32_t>(d_triangles.data() + node.leftFirst, node.count);
+		}
+
+		if (!visitor(node.min, node.max, data) || node.count)
+		{
+			continue;
+		}
+
+		stack[top++] = node.leftFirst + 1;
+		stack[top++] = node.leftFirst;
+	}
+
+	return true;
+}
+
+static_assert(octree::SpatialQuery<TriangleBvh>);
+
+} // end namespace bvh
@@ -205,6 +205,11 @@ bool FreeCamera::isPointInsideFrustum(const glm::vec3& p) const
 	return true;
 }
 
+const std::array<glm::vec4, 6>& FreeCamera::planes() const
+{
+	return d_planes;
+}
+
 void FreeCamera::updateCameraVectors()
 {
 	// Calculate the new Front vector
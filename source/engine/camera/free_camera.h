@@ -38,6 +38,7 @@ public:
 	const glm::vec3& right() const;
 
 	bool isPointInsideFrustum(const glm::vec3& p) const;
+	const std::array<glm::vec4, 6>& planes() const;
 
 
 private:
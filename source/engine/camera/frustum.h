@@ -0,0 +1,105 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <glm/glm.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define CAMERA_FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace camera
+{
+
+enum Visibility
+{
+	VISIBILITY_OUTSIDE = 0,
+	VISIBILITY_INTERSECT,
+	VISIBILITY_INSIDE
+};
+
+// six frustum planes (a, b, c, d), normals pointing inside, stored as SoA so
+// one box is classified against four planes per SSE instruction.
+// the two padding planes (0, 0, 0, 1) accept everything.
+struct Frustum
+{
+	alignas(16) float nx[8];
+	alignas(16) float ny[8];
+	alignas(16) float nz[8];
+	alignas(16) float d[8];
+
+	explicit Frustum(const std::array<glm::vec4, 6>& planes)
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			const glm::vec4 plane = i < 6 ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			nx[i] = plane.x;
+			ny[i] = plane.y;
+			nz[i] = plane.z;
+			d[i] = plane.w;
+		}
+	}
+
+	Visibility classify(const glm::vec3& min, const glm::vec3& max) const
+	{
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extent = (max - min) * 0.5f;
+
+#if defined(CAMERA_FRUSTUM_SSE)
+		const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+		const __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+		const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+		int outside = 0, intersect = 0;
+		for (int i = 0; i < 8; i += 4)
+		{
+			const __m128 px = _mm_load_ps(nx + i), py = _mm_load_ps(ny + i), pz = _mm_load_ps(nz + i);
+
+			// signed distance of the center and projected radius of the box on the plane normal
+			__m128 dist = _mm_add_ps(_mm_mul_ps(px, cx), _mm_load_ps(d + i));
+			dist = _mm_add_ps(dist, _mm_mul_ps(py, cy));
+			dist = _mm_add_ps(dist, _mm_mul_ps(pz, cz));
+
+			__m128 radius = _mm_mul_ps(_mm_andnot_ps(sign_mask, px), ex);
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_andnot_ps(sign_mask, py), ey));
+			radius = _mm_add_ps(radius, _mm_mul_ps(_mm_andnot_ps(sign_mask, pz), ez));
+
+			outside |= _mm_movemask_ps(_mm_cmple_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+			intersect |= _mm_movemask_ps(_mm_cmple_ps(_mm_sub_ps(dist, radius), _mm_setzero_ps()));
+		}
+#else
+		int outside = 0, intersect = 0;
+		for (int i = 0; i < 8; ++i)
+		{
+			const float dist = nx[i] * center.x + ny[i] * center.y + nz[i] * center.z + d[i];
+			const float radius = std::abs(nx[i]) * extent.x + std::abs(ny[i]) * extent.y + std::abs(nz[i]) * extent.z;
+			outside |= (dist + radius <= 0.0f) ? 1 : 0;
+			intersect |= (dist - radius <= 0.0f) ? 1 : 0;
+		}
+#endif
+
+		if (outside)
+		{
+			return VISIBILITY_OUTSIDE;
+		}
+		return intersect ? VISIBILITY_INTERSECT : VISIBILITY_INSIDE;
+	}
+
+	// false when the sphere is completely outside a plane. the plane normals are not unit length,
+	// the radius is scaled to match.
+	bool intersects(const glm::vec3& center, float radius) const
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			const float dist = nx[i] * center.x + ny[i] * center.y + nz[i] * center.z + d[i];
+			const float scale = std::sqrt(nx[i] * nx[i] + ny[i] * ny[i] + nz[i] * nz[i]);
+			if (dist + radius * scale <= 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+}// end namespace camera
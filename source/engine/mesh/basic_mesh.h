@@ -36,4 +36,11 @@ struct BasicMesh
 	std::vector<uint32_t> indices;
 };
 
+// coarser triangles over the vertices of a mesh and how far they deviate from it, in mesh units
+struct MeshLod
+{
+	std::vector<uint32_t> indices;
+	float error = 0.0f;
+};
+
 } // end namespace mesh
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace mesh
+{
+
+// 48 bytes, matches a std430 struct of two vec4 and four uint, so MeshletMesh::meshlets uploads as is.
+// the triangles of a meshlet index its vertices, which index the vertices of the mesh.
+struct Meshlet
+{
+	glm::vec4 sphere = glm::vec4(0.0f);                 // center and radius of the bounding sphere
+	glm::vec4 cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // normal cone axis and sine of its half angle, 1 never culls
+	uint32_t vertex_offset = 0;   // into MeshletMesh::vertices
+	uint32_t triangle_offset = 0; // into MeshletMesh::triangles, in bytes, 4 byte aligned
+	uint32_t vertex_count = 0;
+	uint32_t triangle_count = 0;
+};
+
+// flat buffers of every meshlet of a mesh
+struct MeshletMesh
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> vertices; // mesh vertex of every meshlet vertex
+	std::vector<uint8_t> triangles; // three meshlet vertices per triangle, every meshlet padded to 4 bytes
+};
+
+// false when every normal in the cone faces away from eye for every point of the sphere. with cone half angle a,
+// the cluster is back facing once the direction from eye to the center is within 90 - a - asin(radius / distance)
+// degrees of the axis, tested conservatively as dot(center - eye, axis) >= sin(a) * distance + radius.
+// off screen clusters are rejected with the sphere against camera::Frustum::intersects.
+inline bool coneVisible(const glm::vec4& sphere, const glm::vec4& cone, const glm::vec3& eye)
+{
+	const glm::vec3 to_center = glm::vec3(sphere) - eye;
+	return glm::dot(to_center, glm::vec3(cone)) < cone.w * glm::length(to_center) + sphere.w;
+}
+
+} // end namespace mesh
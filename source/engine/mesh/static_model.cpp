@@ -3,6 +3,8 @@
 #include <assert.h>
 
 #include "../util/image_utils.h"
+#include "util.h"
+#include "../util/parallel.h"
 
 #include <iostream>
 
@@ -33,11 +35,32 @@ bool StaticModel::gammaCorrection() const
 	return false;
 }
 
+void StaticModel::buildLods(size_t levels, float ratio, float max_error)
+{
+	d_lods.assign(d_meshes.size(), {});
+	util::Parallel::forEach(d_meshes.size(), [&](size_t i) {
+		Utility::buildLods(*d_meshes[i], levels, ratio, max_error, d_lods[i]);
+	}, 1);
+
+	size_t level_count = 0;
+	for (const auto& chain : d_lods)
+	{
+		level_count += chain.size();
+	}
+	SDL_Log("static model lods: %zu levels over %zu meshes", level_count, d_meshes.size());
+}
+
+const std::vector<MeshLod>& StaticModel::lods(size_t mesh) const
+{
+	static const std::vector<MeshLod> NONE;
+	return mesh < d_lods.size() ? d_lods[mesh] : NONE;
+}
+
 void StaticModel::loadModel(const std::string& path)
 {
 	// read file via ASSIMP
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
 	// check for errors
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
 	{
@@ -49,6 +72,25 @@ void StaticModel::loadModel(const std::string& path)
 
 	processNode(scene->mRootNode, scene);
 
+	// the importer keeps every corner of the file as its own vertex
+	util::Parallel::forEach(d_meshes.size(), [&](size_t i) {
+		Utility::weldVertices(*d_meshes[i]);
+	}, 1);
+
+	// tangents are generated here instead of by the importer, which runs single threaded
+	for (auto& mesh : d_meshes)
+	{
+		if (mesh->tangents.empty() && !mesh->texcoords.empty())
+		{
+			Utility::computeTangents(*mesh);
+		}
+	}
+
+	// assimp keeps the triangle order of the file, reorder for the vertex cache once all streams exist
+	util::Parallel::forEach(d_meshes.size(), [&](size_t i) {
+		Utility::optimizeMesh(*d_meshes[i]);
+	}, 1);
+
 	// material retrieval
 	for (const auto& elem : d_added)
 	{
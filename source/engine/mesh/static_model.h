@@ -27,8 +27,14 @@ public:
 	const std::vector<std::shared_ptr<Image2D>>& textures() const;
 	bool gammaCorrection() const;
 
+	// LOD chain of every mesh, meshes are simplified in parallel. see Utility::buildLods, max_error is in model units.
+	void buildLods(size_t levels, float ratio, float max_error);
+	// finest first, empty until buildLods
+	const std::vector<MeshLod>& lods(size_t mesh) const;
+
 private:
 	std::vector<std::shared_ptr<BasicMesh>> d_meshes;
+	std::vector<std::vector<MeshLod>> d_lods;
 	std::vector<std::shared_ptr<Image2D>> d_textures;
 	bool d_gammaCorrection = false;
 
@@ -1,65 +1,829 @@
 #include "util.h"
 #include <SDL2/SDL.h>
 #include <assert.h>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <functional>
+#include <unordered_map>
+#include "../util/parallel.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define MESH_UTIL_SSE 1
+#include <xmmintrin.h>
+#endif
 
 namespace mesh
 {
 
+namespace
+{
 
+// triangles per worker chunk, smaller meshes run on the calling thread
+const size_t SCATTER_CHUNK_TRIANGLES = 1 << 15;
 
+// weighted face normal of triangle a, b, c for each of its corners.
+// the cross product is twice the area long, so area weighting is the cross product itself.
+void cornerNormals(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, Utility::NormalWeight weight, glm::vec3 (&out)[3])
+{
+	const glm::vec3 ab = b - a;
+	const glm::vec3 ac = c - a;
+	const glm::vec3 normal = glm::cross(ab, ac);
 
-Utility::Utility()
+	if (weight == Utility::NORMAL_WEIGHT_AREA)
+	{
+		out[0] = out[1] = out[2] = normal;
+		return;
+	}
+
+	const float length = glm::length(normal);
+	const float lab = glm::length(ab), lac = glm::length(ac), lbc = glm::length(c - b);
+	if (length <= 0.0f || lab <= 0.0f || lac <= 0.0f || lbc <= 0.0f)
+	{
+		out[0] = out[1] = out[2] = glm::vec3(0.0f);
+		return;
+	}
+
+	const glm::vec3 unit = normal / length;
+	const float angle_a = std::acos(std::clamp(glm::dot(ab, ac) / (lab * lac), -1.0f, 1.0f));
+	const float angle_b = std::acos(std::clamp(glm::dot(-ab, c - b) / (lab * lbc), -1.0f, 1.0f));
+	out[0] = unit * angle_a;
+	out[1] = unit * angle_b;
+	out[2] = unit * std::max(3.14159265f - angle_a - angle_b, 0.0f);
+}
+
+#if defined(MESH_UTIL_SSE)
+// cornerNormals of four triangles at once, the cross products, lengths and corner cosines run on SSE lanes
+void cornerNormals4(const glm::vec3* const (&corners)[4][3], Utility::NormalWeight weight, glm::vec3 (&out)[4][3])
 {
+	auto lane = [&](int corner, int axis) {
+		return _mm_setr_ps((*corners[0][corner])[axis], (*corners[1][corner])[axis], (*corners[2][corner])[axis], (*corners[3][corner])[axis]);
+	};
+
+	const __m128 ax = lane(0, 0), ay = lane(0, 1), az = lane(0, 2);
+	const __m128 abx = _mm_sub_ps(lane(1, 0), ax);
+	const __m128 aby = _mm_sub_ps(lane(1, 1), ay);
+	const __m128 abz = _mm_sub_ps(lane(1, 2), az);
+	const __m128 acx = _mm_sub_ps(lane(2, 0), ax);
+	const __m128 acy = _mm_sub_ps(lane(2, 1), ay);
+	const __m128 acz = _mm_sub_ps(lane(2, 2), az);
+
+	const __m128 crossx = _mm_sub_ps(_mm_mul_ps(aby, acz), _mm_mul_ps(abz, acy));
+	const __m128 crossy = _mm_sub_ps(_mm_mul_ps(abz, acx), _mm_mul_ps(abx, acz));
+	const __m128 crossz = _mm_sub_ps(_mm_mul_ps(abx, acy), _mm_mul_ps(aby, acx));
+
+	alignas(16) float nx[4], ny[4], nz[4];
+	_mm_store_ps(nx, crossx);
+	_mm_store_ps(ny, crossy);
+	_mm_store_ps(nz, crossz);
+
+	if (weight == Utility::NORMAL_WEIGHT_AREA)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			out[i][0] = out[i][1] = out[i][2] = glm::vec3(nx[i], ny[i], nz[i]);
+		}
+		return;
+	}
+
+	auto dot = [](__m128 x0, __m128 y0, __m128 z0, __m128 x1, __m128 y1, __m128 z1) {
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, x1), _mm_mul_ps(y0, y1)), _mm_mul_ps(z0, z1));
+	};
+
+	const __m128 bcx = _mm_sub_ps(acx, abx);
+	const __m128 bcy = _mm_sub_ps(acy, aby);
+	const __m128 bcz = _mm_sub_ps(acz, abz);
+
+	const __m128 lab = _mm_sqrt_ps(dot(abx, aby, abz, abx, aby, abz));
+	const __m128 lac = _mm_sqrt_ps(dot(acx, acy, acz, acx, acy, acz));
+	const __m128 lbc = _mm_sqrt_ps(dot(bcx, bcy, bcz, bcx, bcy, bcz));
+
+	// the angle at b is between -ab and bc
+	alignas(16) float dot_a[4], dot_b[4], len_a[4], len_b[4], len_n[4], shortest[4];
+	_mm_store_ps(dot_a, dot(abx, aby, abz, acx, acy, acz));
+	_mm_store_ps(dot_b, _mm_sub_ps(_mm_setzero_ps(), dot(abx, aby, abz, bcx, bcy, bcz)));
+	_mm_store_ps(len_a, _mm_mul_ps(lab, lac));
+	_mm_store_ps(len_b, _mm_mul_ps(lab, lbc));
+	_mm_store_ps(len_n, _mm_sqrt_ps(dot(crossx, crossy, crossz, crossx, crossy, crossz)));
+	_mm_store_ps(shortest, _mm_min_ps(_mm_min_ps(lab, lac), lbc));
+
+	for (int i = 0; i < 4; ++i)
+	{
+		if (len_n[i] <= 0.0f || shortest[i] <= 0.0f)
+		{
+			out[i][0] = out[i][1] = out[i][2] = glm::vec3(0.0f);
+			continue;
+		}
+
+		const glm::vec3 unit = glm::vec3(nx[i], ny[i], nz[i]) / len_n[i];
+		const float angle_a = std::acos(std::clamp(dot_a[i] / len_a[i], -1.0f, 1.0f));
+		const float angle_b = std::acos(std::clamp(dot_b[i] / len_b[i], -1.0f, 1.0f));
+		out[i][0] = unit * angle_a;
+		out[i][1] = unit * angle_b;
+		out[i][2] = unit * std::max(3.14159265f - angle_a - angle_b, 0.0f);
+	}
 }
+#endif
 
-Utility::~Utility()
+// sums a value per triangle corner into its vertex for every triangle of mesh, in worker chunks.
+// fn(begin, end, add) handles the triangles [begin, end) and calls add(vertex, value) per corner.
+// every chunk sums into a private window over the vertex range its triangles touch, meshes keep
+// neighbouring triangles on neighbouring vertices so the windows barely overlap. when the index order is
+// so scattered that the windows would outgrow the mesh, chunks add straight into sums with atomic adds.
+// Sum is a plain struct of floats with operator+=.
+template <class Sum, class Fn>
+void scatterTriangles(const BasicMesh& mesh, std::vector<Sum>& sums, Fn&& fn)
 {
+	static_assert(sizeof(Sum) % sizeof(float) == 0, "sums are added float by float in the shared mode");
+
+	const size_t triangle_count = mesh.indices.size() / 3;
+	const size_t vertex_count = mesh.positions.size();
+	const size_t chunks = util::Parallel::chunkCount(triangle_count, SCATTER_CHUNK_TRIANGLES);
+
+	struct Window
+	{
+		uint32_t first = UINT32_MAX;
+		uint32_t last = 0;
+		std::vector<Sum> sums;
+	};
+	std::vector<Window> windows(chunks);
+
+	util::Parallel::forEachChunk(triangle_count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+		auto& window = windows[chunk];
+		for (size_t i = begin * 3; i < end * 3; ++i)
+		{
+			window.first = std::min(window.first, mesh.indices[i]);
+			window.last = std::max(window.last, mesh.indices[i]);
+		}
+	});
+
+	size_t window_total = 0;
+	for (const auto& window : windows)
+	{
+		window_total += window.first <= window.last ? window.last - window.first + 1 : 0;
+	}
+
+	const bool shared = chunks > 1 && window_total > 2 * vertex_count;
+
+	sums.assign(vertex_count, Sum());
+
+	util::Parallel::forEachChunk(triangle_count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+		auto& window = windows[chunk];
+		if (!shared && window.first <= window.last)
+		{
+			window.sums.assign(window.last - window.first + 1, Sum());
+		}
+
+		fn(begin, end, [&](uint32_t index, const Sum& value) {
+			if (index >= vertex_count)
+			{
+				return;
+			}
+
+			if (shared)
+			{
+				const float* from = reinterpret_cast<const float*>(&value);
+				float* to = reinterpret_cast<float*>(&sums[index]);
+				for (size_t i = 0; i < sizeof(Sum) / sizeof(float); ++i)
+				{
+					std::atomic_ref<float>(to[i]).fetch_add(from[i], std::memory_order_relaxed);
+				}
+			}
+			else
+			{
+				window.sums[index - window.first] += value;
+			}
+		});
+	});
+
+	if (shared)
+	{
+		return;
+	}
+
+	// reduction, every vertex adds the windows covering it
+	util::Parallel::forEach(vertex_count, [&](size_t i) {
+		for (const auto& window : windows)
+		{
+			if (i >= window.first && i <= window.last && !window.sums.empty())
+			{
+				sums[i] += window.sums[i - window.first];
+			}
+		}
+	});
 }
 
-bool Utility::computeNormals(BasicMesh& mesh, bool force_replace_old_normals)
+// triangle lists the cache passes can reorder, every index inside the positions
+bool validTriangles(const BasicMesh& mesh)
 {
-	if (mesh.indices.empty() || mesh.positions.empty())
+	if (mesh.indices.empty() || mesh.positions.empty() || mesh.indices.size() % 3 != 0)
 	{
 		SDL_Log("invalid mesh input, postions or indices are empty");
 		return false;
 	}
 
-	if (mesh.normals.empty() == false || force_replace_old_normals == false)
+	for (const auto& index : mesh.indices)
 	{
-		SDL_Log("mesh contains non empty normals skip this operations");
+		if (index >= mesh.positions.size())
+		{
+			SDL_Log("invalid mesh input, index %u out of %zu vertices", index, mesh.positions.size());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// every attribute stream empty or one entry per position
+bool validStreams(const BasicMesh& mesh)
+{
+	const size_t vertex_count = mesh.positions.size();
+	auto sized = [&](const auto& stream) { return stream.empty() || stream.size() == vertex_count; };
+	if (!sized(mesh.texcoords) || !sized(mesh.normals) || !sized(mesh.tangents) || !sized(mesh.bitangents) || !sized(mesh.colors))
+	{
+		SDL_Log("invalid mesh input, attribute streams and positions differ in size");
 		return false;
 	}
 
-	std::vector<uint32_t> count;
-	mesh.normals.clear();
-	mesh.normals.resize(mesh.positions.size());
-	count.resize(mesh.positions.size(), 0);
+	return true;
+}
+
+// moves vertex v of every stream to remap[v], count vertices remain. vertices mapped to UINT32_MAX are dropped,
+// at most one vertex may map to each slot.
+void remapStreams(BasicMesh& mesh, const std::vector<uint32_t>& remap, size_t count)
+{
+	auto apply = [&](auto& stream) {
+		if (stream.empty())
+		{
+			return;
+		}
+
+		std::remove_reference_t<decltype(stream)> result(count);
+		util::Parallel::forEach(remap.size(), [&](size_t v) {
+			if (remap[v] != UINT32_MAX)
+			{
+				result[remap[v]] = stream[v];
+			}
+		});
+		stream.swap(result);
+	};
+
+	apply(mesh.positions);
+	apply(mesh.texcoords);
+	apply(mesh.normals);
+	apply(mesh.tangents);
+	apply(mesh.bitangents);
+	apply(mesh.colors);
+}
+
+// vertices transformed by a FIFO cache of cache_size entries drawing indices, optionally the misses of every triangle.
+// a vertex is cached while fewer than cache_size misses happened since its own.
+size_t simulateVertexCache(const std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size, std::vector<uint8_t>* triangle_misses = nullptr)
+{
+	std::vector<size_t> cache_time(vertex_count, 0);
+	size_t time = cache_size + 1;
+
+	if (triangle_misses)
+	{
+		triangle_misses->assign(indices.size() / 3, 0);
+	}
+
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		const uint32_t v = indices[i];
+		if (time - cache_time[v] > cache_size)
+		{
+			cache_time[v] = time++;
+			if (triangle_misses)
+			{
+				++(*triangle_misses)[i / 3];
+			}
+		}
+	}
+
+	return time - cache_size - 1;
+}
+
+// half edge collapse simplifier over the triangles of a mesh. vertices never move, a collapse replaces one vertex
+// by a neighbour, so every level indexes the vertex buffer of the full mesh. the quadrics live in the space of
+// position, normal and uv (Garland and Heckbert 1998), attributes scaled to a fraction of the mesh radius, and
+// vertices on attribute seams or open borders are locked.
+class Simplifier
+{
+public:
+	// deviation of a unit normal or uv difference, as a fraction of the mesh radius
+	static constexpr double NORMAL_WEIGHT = 0.05;
+	static constexpr double UV_WEIGHT = 0.05;
+	static constexpr size_t MAX_DIMENSION = 8;
+
+	explicit Simplifier(const BasicMesh& mesh)
+		: d_mesh(mesh)
+		, d_triangles(mesh.indices)
+		, d_alive(mesh.indices.size() / 3, 1)
+		, d_aliveCount(mesh.indices.size() / 3)
+	{
+		const size_t vertex_count = mesh.positions.size();
+		d_dimension = 3 + (mesh.normals.empty() ? 0 : 3) + (mesh.texcoords.empty() ? 0 : 2);
+		d_stride = d_dimension * (d_dimension + 1) / 2 + d_dimension + 2;
+
+		glm::vec3 min(std::numeric_limits<float>::max());
+		glm::vec3 max(std::numeric_limits<float>::lowest());
+		for (const auto& pt : mesh.positions)
+		{
+			min = glm::min(min, pt);
+			max = glm::max(max, pt);
+		}
+		const double radius = std::max(0.5 * glm::length(max - min), 1e-6);
+		d_normalScale = NORMAL_WEIGHT * radius;
+		d_uvScale = UV_WEIGHT * radius;
+
+		d_removed.assign(vertex_count, 0);
+		d_version.assign(vertex_count, 0);
+		d_adjacency.resize(vertex_count);
+		for (size_t i = 0; i < d_triangles.size(); ++i)
+		{
+			d_adjacency[d_triangles[i]].push_back((uint32_t)(i / 3));
+		}
+
+		lockSeamsAndBorders();
+		buildQuadrics();
+
+		for (size_t tri = 0; tri < d_alive.size(); ++tri)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				pushCollapse(d_triangles[tri * 3 + c], d_triangles[tri * 3 + (c + 1) % 3]);
+				pushCollapse(d_triangles[tri * 3 + (c + 1) % 3], d_triangles[tri * 3 + c]);
+			}
+		}
+	}
+
+	// collapses the cheapest edges until at most target triangles are left. false once the next collapse would
+	// exceed max_error or nothing can collapse any more.
+	bool run(size_t target_triangles, float max_error)
+	{
+		const double limit = (double)max_error * max_error;
+		while (d_aliveCount > target_triangles)
+		{
+			if (d_heap.empty() || d_heap.top().cost > limit)
+			{
+				return false;
+			}
+
+			const Collapse collapse = d_heap.top();
+			d_heap.pop();
+
+			if (d_removed[collapse.from] || d_removed[collapse.to] ||
+				d_version[collapse.from] != collapse.from_version || d_version[collapse.to] != collapse.to_version ||
+				!keepsOrientation(collapse.from, collapse.to))
+			{
+				continue;
+			}
+
+			apply(collapse);
+		}
+		return true;
+	}
+
+	size_t triangleCount() const
+	{
+		return d_aliveCount;
+	}
+
+	// largest deviation of an applied collapse, the root mean square distance its quadric measured
+	float error() const
+	{
+		return (float)d_error;
+	}
+
+	void indices(std::vector<uint32_t>& output) const
+	{
+		output.clear();
+		output.reserve(d_aliveCount * 3);
+		for (size_t tri = 0; tri < d_alive.size(); ++tri)
+		{
+			if (d_alive[tri])
+			{
+				output.insert(output.end(), d_triangles.begin() + tri * 3, d_triangles.begin() + tri * 3 + 3);
+			}
+		}
+	}
+
+private:
+	struct Collapse
+	{
+		double cost;
+		uint32_t from;
+		uint32_t to;
+		uint32_t from_version;
+		uint32_t to_version;
+
+		bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	const BasicMesh& d_mesh;
+	std::vector<uint32_t> d_triangles;
+	std::vector<char> d_alive;
+	size_t d_aliveCount = 0;
+	std::vector<char> d_removed;
+	std::vector<char> d_locked;
+	std::vector<uint32_t> d_version;
+	std::vector<std::vector<uint32_t>> d_adjacency; // triangles around every vertex, dead ones dropped lazily
+	std::vector<double> d_quadrics;                 // symmetric A, b, c and the summed area per vertex
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> d_heap;
+	size_t d_dimension = 3;
+	size_t d_stride = 0;
+	double d_normalScale = 0.0;
+	double d_uvScale = 0.0;
+	double d_error = 0.0;
+	std::vector<uint32_t> d_neighbours;
+
+	void point(uint32_t v, double (&out)[MAX_DIMENSION]) const
+	{
+		size_t n = 0;
+		const glm::vec3& p = d_mesh.positions[v];
+		out[n++] = p.x;
+		out[n++] = p.y;
+		out[n++] = p.z;
+
+		if (!d_mesh.normals.empty())
+		{
+			const glm::vec3& normal = d_mesh.normals[v];
+			out[n++] = normal.x * d_normalScale;
+			out[n++] = normal.y * d_normalScale;
+			out[n++] = normal.z * d_normalScale;
+		}
+
+		if (!d_mesh.texcoords.empty())
+		{
+			const glm::vec2& uv = d_mesh.texcoords[v];
+			out[n++] = uv.x * d_uvScale;
+			out[n++] = uv.y * d_uvScale;
+		}
+	}
+
+	// vertices sharing their position with another vertex sit on a seam, edges used once or more than twice
+	// are borders or non manifold. moving any of them would tear the surface.
+	void lockSeamsAndBorders()
+	{
+		const size_t vertex_count = d_mesh.positions.size();
+		d_locked.assign(vertex_count, 0);
+
+		struct PositionHash
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				return std::hash<float>()(p.x) ^ (std::hash<float>()(p.y) << 1) ^ (std::hash<float>()(p.z) << 2);
+			}
+		};
+
+		std::unordered_map<glm::vec3, uint32_t, PositionHash> first_at;
+		std::vector<uint32_t> group(vertex_count);
+		for (uint32_t v = 0; v < vertex_count; ++v)
+		{
+			auto [it, added] = first_at.emplace(d_mesh.positions[v] + glm::vec3(0.0f), v);
+			group[v] = it->second;
+			if (!added)
+			{
+				d_locked[v] = 1;
+				d_locked[it->second] = 1;
+			}
+		}
+
+		std::unordered_map<uint64_t, uint32_t> edge_use;
+		auto edge_key = [&](uint32_t a, uint32_t b) {
+			const uint64_t ga = group[a], gb = group[b];
+			return ga < gb ? (ga << 32) | gb : (gb << 32) | ga;
+		};
+
+		for (size_t tri = 0; tri < d_alive.size(); ++tri)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				++edge_use[edge_key(d_triangles[tri * 3 + c], d_triangles[tri * 3 + (c + 1) % 3])];
+			}
+		}
+
+		for (size_t tri = 0; tri < d_alive.size(); ++tri)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				const uint32_t a = d_triangles[tri * 3 + c], b = d_triangles[tri * 3 + (c + 1) % 3];
+				if (edge_use[edge_key(a, b)] != 2)
+				{
+					d_locked[a] = 1;
+					d_locked[b] = 1;
+				}
+			}
+		}
+	}
+
+	// area weighted squared distance to the plane of every triangle in the attribute space, summed per vertex with the area
+	void buildQuadrics()
+	{
+		const size_t n = d_dimension;
+		d_quadrics.assign(d_mesh.positions.size() * d_stride, 0.0);
+
+		for (size_t tri = 0; tri < d_alive.size(); ++tri)
+		{
+			double p[3][MAX_DIMENSION];
+			for (int c = 0; c < 3; ++c)
+			{
+				point(d_triangles[tri * 3 + c], p[c]);
+			}
+
+			// orthonormal e1, e2 spanning the triangle
+			double e1[MAX_DIMENSION], e2[MAX_DIMENSION];
+			double l1 = 0.0, d12 = 0.0;
+			for (size_t i = 0; i < n; ++i)
+			{
+				e1[i] = p[1][i] - p[0][i];
+				l1 += e1[i] * e1[i];
+			}
+			l1 = std::sqrt(l1);
+			if (l1 <= 0.0)
+			{
+				continue;
+			}
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				e1[i] /= l1;
+				e2[i] = p[2][i] - p[0][i];
+				d12 += e1[i] * e2[i];
+			}
+
+			double l2 = 0.0;
+			for (size_t i = 0; i < n; ++i)
+			{
+				e2[i] -= d12 * e1[i];
+				l2 += e2[i] * e2[i];
+			}
+			l2 = std::sqrt(l2);
+			if (l2 <= 0.0)
+			{
+				continue;
+			}
+
+			double pe1 = 0.0, pe2 = 0.0, pp = 0.0;
+			for (size_t i = 0; i < n; ++i)
+			{
+				e2[i] /= l2;
+				pe1 += p[0][i] * e1[i];
+				pe2 += p[0][i] * e2[i];
+				pp += p[0][i] * p[0][i];
+			}
+
+			const glm::vec3& a = d_mesh.positions[d_triangles[tri * 3 + 0]];
+			const double area = 0.5 * glm::length(glm::cross(d_mesh.positions[d_triangles[tri * 3 + 1]] - a, d_mesh.positions[d_triangles[tri * 3 + 2]] - a));
+
+			// A = I - e1 e1^T - e2 e2^T, b = (p.e1) e1 + (p.e2) e2 - p, c = p.p - (p.e1)^2 - (p.e2)^2
+			double q[MAX_DIMENSION * (MAX_DIMENSION + 1) / 2 + MAX_DIMENSION + 2];
+			size_t k = 0;
+			for (size_t i = 0; i < n; ++i)
+			{
+				for (size_t j = i; j < n; ++j)
+				{
+					q[k++] = area * ((i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j]);
+				}
+			}
+			for (size_t i = 0; i < n; ++i)
+			{
+				q[k++] = area * (pe1 * e1[i] + pe2 * e2[i] - p[0][i]);
+			}
+			q[k++] = area * (pp - pe1 * pe1 - pe2 * pe2);
+			q[k++] = area;
+
+			for (int c = 0; c < 3; ++c)
+			{
+				double* dst = d_quadrics.data() + d_triangles[tri * 3 + c] * d_stride;
+				for (size_t i = 0; i < d_stride; ++i)
+				{
+					dst[i] += q[i];
+				}
+			}
+		}
+	}
+
+	// x^T A x + 2 b^T x + c of the quadric of vertex v at point x, still scaled by the area
+	double evaluate(uint32_t v, const double (&x)[MAX_DIMENSION]) const
+	{
+		const size_t n = d_dimension;
+		const double* q = d_quadrics.data() + v * d_stride;
+		double result = 0.0;
+		size_t k = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			result += q[k++] * x[i] * x[i];
+			for (size_t j = i + 1; j < n; ++j)
+			{
+				result += 2.0 * q[k++] * x[i] * x[j];
+			}
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			result += 2.0 * q[k++] * x[i];
+		}
+		return std::max(result + q[k], 0.0);
+	}
+
+	double area(uint32_t v) const
+	{
+		return d_quadrics[v * d_stride + d_stride - 1];
+	}
+
+	void pushCollapse(uint32_t from, uint32_t to)
+	{
+		if (d_locked[from] || from == to)
+		{
+			return;
+		}
+
+		// mean squared distance over the area of both quadrics
+		double x[MAX_DIMENSION];
+		point(to, x);
+		const double area_sum = area(from) + area(to);
+		const double cost = area_sum > 0.0 ? (evaluate(from, x) + evaluate(to, x)) / area_sum : 0.0;
+		d_heap.push({ cost, from, to, d_version[from], d_version[to] });
+	}
+
+	// no triangle around from may flip or lose its area when from moves onto to
+	bool keepsOrientation(uint32_t from, uint32_t to) const
+	{
+		const glm::vec3& target = d_mesh.positions[to];
+		for (const auto& tri : d_adjacency[from])
+		{
+			if (!d_alive[tri])
+			{
+				continue;
+			}
+
+			const uint32_t* corners = d_triangles.data() + tri * 3;
+			if (corners[0] == to || corners[1] == to || corners[2] == to)
+			{
+				continue;
+			}
+
+			glm::vec3 p[3], moved[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				p[c] = d_mesh.positions[corners[c]];
+				moved[c] = corners[c] == from ? target : p[c];
+			}
+
+			const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			const glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			if (glm::dot(before, after) <= 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
 
-	for (size_t i = 0; i < mesh.normals.size(); i += 3)
+	void apply(const Collapse& collapse)
 	{
-		uint32_t i0 = mesh.indices[i];
-		uint32_t i1 = mesh.indices[i + 1];
-		uint32_t i2 = mesh.indices[i + 2];
+		const uint32_t from = collapse.from, to = collapse.to;
+
+		double* dst = d_quadrics.data() + to * d_stride;
+		const double* src = d_quadrics.data() + from * d_stride;
+		for (size_t i = 0; i < d_stride; ++i)
+		{
+			dst[i] += src[i];
+		}
+
+		d_removed[from] = 1;
+		++d_version[from];
+		++d_version[to];
+		d_error = std::max(d_error, std::sqrt(collapse.cost));
+
+		for (const auto& tri : d_adjacency[from])
+		{
+			if (!d_alive[tri])
+			{
+				continue;
+			}
+
+			uint32_t* corners = d_triangles.data() + tri * 3;
+			if (corners[0] == to || corners[1] == to || corners[2] == to)
+			{
+				d_alive[tri] = 0;
+				--d_aliveCount;
+				continue;
+			}
+
+			for (int c = 0; c < 3; ++c)
+			{
+				corners[c] = corners[c] == from ? to : corners[c];
+			}
+			d_adjacency[to].push_back(tri);
+		}
+		d_adjacency[from] = std::vector<uint32_t>();
+
+		auto& around = d_adjacency[to];
+		around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t tri) { return !d_alive[tri]; }), around.end());
+
+		// the quadric of to changed, every edge at it gets a new cost
+		d_neighbours.clear();
+		for (const auto& tri : around)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				if (d_triangles[tri * 3 + c] != to)
+				{
+					d_neighbours.push_back(d_triangles[tri * 3 + c]);
+				}
+			}
+		}
+
+		std::sort(d_neighbours.begin(), d_neighbours.end());
+		d_neighbours.erase(std::unique(d_neighbours.begin(), d_neighbours.end()), d_neighbours.end());
+		for (const auto& other : d_neighbours)
+		{
+			pushCollapse(other, to);
+			pushCollapse(to, other);
+		}
+	}
+};
+
+} // end anonymous namespace
 
-		auto vec1 = mesh.positions[i1] - mesh.positions[i0];
-		auto vec2 = mesh.positions[i2] - mesh.positions[i0];
-		auto normal = glm::cross(vec1, vec2);
+Utility::Utility()
+{
+}
 
-		mesh.normals[i0] += normal;
-		mesh.normals[i1] += normal;
-		mesh.normals[i2] += normal;
+Utility::~Utility()
+{
+}
 
-		++count[i0];
-		++count[i1];
-		++count[i2];
+bool Utility::computeNormals(BasicMesh& mesh, bool force_replace_old_normals, NormalWeight weight)
+{
+	if (mesh.indices.empty() || mesh.positions.empty())
+	{
+		SDL_Log("invalid mesh input, postions or indices are empty");
+		return false;
 	}
 
-	for (size_t i = 0; i < mesh.normals.size(); ++i)
+	if (mesh.normals.empty() == false && force_replace_old_normals == false)
 	{
-		mesh.normals[i] /= count[i];
-		mesh.normals[i] = glm::normalize(mesh.normals[i]);
+		SDL_Log("mesh contains non empty normals skip this operations");
+		return false;
 	}
 
+	const size_t vertex_count = mesh.positions.size();
+	auto corner = [&](size_t i) -> const glm::vec3& {
+		return mesh.positions[std::min<size_t>(mesh.indices[i], vertex_count - 1)];
+	};
+
+	scatterTriangles(mesh, mesh.normals, [&](size_t begin, size_t end, auto&& add) {
+		size_t tri = begin;
+#if defined(MESH_UTIL_SSE)
+		for (; tri + 4 <= end; tri += 4)
+		{
+			const glm::vec3* corners[4][3];
+			for (int t = 0; t < 4; ++t)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					corners[t][c] = &corner((tri + t) * 3 + c);
+				}
+			}
+
+			glm::vec3 normals[4][3];
+			cornerNormals4(corners, weight, normals);
+
+			for (int t = 0; t < 4; ++t)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					add(mesh.indices[(tri + t) * 3 + c], normals[t][c]);
+				}
+			}
+		}
+#endif
+		for (; tri < end; ++tri)
+		{
+			glm::vec3 normals[3];
+			cornerNormals(corner(tri * 3), corner(tri * 3 + 1), corner(tri * 3 + 2), weight, normals);
+
+			for (int c = 0; c < 3; ++c)
+			{
+				add(mesh.indices[tri * 3 + c], normals[c]);
+			}
+		}
+	});
+
+	util::Parallel::forEach(vertex_count, [&](size_t i) {
+		const float length = glm::length(mesh.normals[i]);
+		mesh.normals[i] = length > 0.0f ? mesh.normals[i] / length : glm::vec3(0.0f);
+	});
+
 	return true;
 }
 
@@ -115,14 +879,7 @@ bool Utility::createVertexArray(const BasicMesh& mesh, std::vector<Vertex>& outp
 	return true;
 }
 
-bool Utility::computeTangents(BasicMesh& mesh_input_output, bool force_replace_old_tangents)
-{
-	assert(0);
-	throw "not implemented.";
-	return false;
-}
-
-bool Utility::transformPointCloud(BasicMesh& mesh, const glm::mat4& matrix)
+bool Utility::computeTangents(BasicMesh& mesh, bool force_replace_old_tangents)
 {
 	if (mesh.indices.empty() || mesh.positions.empty())
 	{
@@ -130,9 +887,868 @@ bool Utility::transformPointCloud(BasicMesh& mesh, const glm::mat4& matrix)
 		return false;
 	}
 
-	for (auto& elem : mesh.positions)
+	if (mesh.texcoords.size() != mesh.positions.size())
 	{
-		elem = glm::vec3(matrix * glm::vec4(elem, 1.0f));
+		SDL_Log("mesh has no texture coordinates, tangents are not defined");
+		return false;
+	}
+
+	if (mesh.tangents.empty() == false && force_replace_old_tangents == false)
+	{
+		SDL_Log("mesh contains non empty tangents skip this operations");
+		return false;
+	}
+
+	// the tangent frame is built around the normals the mesh is shaded with
+	if (mesh.normals.size() != mesh.positions.size())
+	{
+		computeNormals(mesh, true, NORMAL_WEIGHT_ANGLE);
+	}
+
+	// index 0 sums the orientation preserving triangles, 1 the mirrored ones
+	struct TangentSum
+	{
+		glm::vec3 tangent[2] = { glm::vec3(0.0f), glm::vec3(0.0f) };
+		float weight[2] = { 0.0f, 0.0f };
+
+		TangentSum& operator+=(const TangentSum& other)
+		{
+			for (int i = 0; i < 2; ++i)
+			{
+				tangent[i] += other.tangent[i];
+				weight[i] += other.weight[i];
+			}
+			return *this;
+		}
+	};
+
+	const size_t vertex_count = mesh.positions.size();
+	std::vector<TangentSum> sums;
+
+	// MikkTSpace: per triangle the unit dP/du, per corner projected onto the plane of the vertex normal and
+	// weighted by the corner angle measured in that plane. mirrored triangles are kept apart, their sign
+	// is all the bitangent needs.
+	scatterTriangles(mesh, sums, [&](size_t begin, size_t end, auto&& add) {
+		for (size_t tri = begin; tri < end; ++tri)
+		{
+			const uint32_t index[3] = { mesh.indices[tri * 3], mesh.indices[tri * 3 + 1], mesh.indices[tri * 3 + 2] };
+			if (index[0] >= vertex_count || index[1] >= vertex_count || index[2] >= vertex_count)
+			{
+				continue;
+			}
+
+			const glm::vec3 d21 = mesh.positions[index[1]] - mesh.positions[index[0]];
+			const glm::vec3 d31 = mesh.positions[index[2]] - mesh.positions[index[0]];
+			const glm::vec2 t21 = mesh.texcoords[index[1]] - mesh.texcoords[index[0]];
+			const glm::vec2 t31 = mesh.texcoords[index[2]] - mesh.texcoords[index[0]];
+
+			// triangles without texture area take their frame from the neighbours
+			const float area = t21.x * t31.y - t21.y * t31.x;
+			if (std::abs(area) <= std::numeric_limits<float>::min())
+			{
+				continue;
+			}
+
+			const int group = area > 0.0f ? 0 : 1;
+			const float sign = area > 0.0f ? 1.0f : -1.0f;
+
+			glm::vec3 os = d21 * t31.y - d31 * t21.y;
+			const float los = glm::length(os);
+			os = los > 0.0f ? os * (sign / los) : os;
+
+			for (int c = 0; c < 3; ++c)
+			{
+				const glm::vec3& n = mesh.normals[index[c]];
+				auto project = [&](const glm::vec3& v) {
+					const glm::vec3 p = v - n * glm::dot(n, v);
+					const float length = glm::length(p);
+					return length > 0.0f ? p / length : p;
+				};
+
+				const glm::vec3& p = mesh.positions[index[c]];
+				const glm::vec3 e1 = project(mesh.positions[index[(c + 1) % 3]] - p);
+				const glm::vec3 e2 = project(mesh.positions[index[(c + 2) % 3]] - p);
+				const float angle = std::acos(std::clamp(glm::dot(e1, e2), -1.0f, 1.0f));
+
+				TangentSum sum;
+				sum.tangent[group] = project(os) * angle;
+				sum.weight[group] = angle;
+				add(index[c], sum);
+			}
+		}
+	});
+
+	mesh.tangents.resize(vertex_count);
+	mesh.bitangents.resize(vertex_count);
+
+	// a vertex shared by mirrored and regular triangles keeps the side with more weight,
+	// MikkTSpace would split it. bitangents follow the sign convention, sign * cross(n, t).
+	util::Parallel::forEach(vertex_count, [&](size_t i) {
+		const auto& sum = sums[i];
+		const glm::vec3& n = mesh.normals[i];
+		const int group = sum.weight[0] >= sum.weight[1] ? 0 : 1;
+
+		glm::vec3 tangent = sum.tangent[group] - n * glm::dot(n, sum.tangent[group]);
+		float length = glm::length(tangent);
+		if (length <= 0.0f)
+		{
+			// no usable triangle, any unit vector in the tangent plane
+			tangent = glm::cross(std::abs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f), n);
+			length = glm::length(tangent);
+		}
+
+		mesh.tangents[i] = length > 0.0f ? tangent / length : glm::vec3(1.0f, 0.0f, 0.0f);
+		mesh.bitangents[i] = glm::cross(n, mesh.tangents[i]) * (group == 0 ? 1.0f : -1.0f);
+	});
+
+	return true;
+}
+
+bool Utility::transformPointCloud(BasicMesh& mesh, const glm::mat4& matrix)
+{
+	if (mesh.indices.empty() || mesh.positions.empty())
+	{
+		SDL_Log("invalid mesh input, postions or indices are empty");
+		return false;
+	}
+
+	for (auto& elem : mesh.positions)
+	{
+		elem = glm::vec3(matrix * glm::vec4(elem, 1.0f));
+	}
+
+	return true;
+}
+
+bool Utility::clusterVertices(const std::vector<Position>& positions, std::span<const uint32_t> indices, const glm::vec3& grid_min, float cell_size,
+	std::vector<uint32_t>& output, float& error)
+{
+	if (indices.empty() || positions.empty() || cell_size <= 0.0f)
+	{
+		SDL_Log("invalid mesh input, postions or indices are empty");
+		return false;
+	}
+
+	struct Cluster
+	{
+		glm::vec3 sum = glm::vec3(0.0f);
+		uint32_t count = 0;
+		uint32_t representative = 0;
+		float distance2 = std::numeric_limits<float>::max();
+	};
+
+	// 21 bits per axis, cells are counted from grid_min
+	auto cell_of = [&](const glm::vec3& p) {
+		const glm::vec3 cell = glm::max((p - grid_min) / cell_size, glm::vec3(0.0f));
+		return (uint64_t)std::min(cell.x, 2097151.0f) |
+			(uint64_t)std::min(cell.y, 2097151.0f) << 21 |
+			(uint64_t)std::min(cell.z, 2097151.0f) << 42;
+	};
+
+	// only the referenced vertices, indices may cover a small part of a large mesh
+	std::vector<uint32_t> vertices(indices.begin(), indices.end());
+	std::sort(vertices.begin(), vertices.end());
+	vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+	auto slot_of = [&](uint32_t index) {
+		return std::lower_bound(vertices.begin(), vertices.end(), index) - vertices.begin();
+	};
+
+	std::vector<uint32_t> cluster_of(vertices.size());
+	std::vector<Cluster> clusters;
+	std::unordered_map<uint64_t, uint32_t> cells;
+
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		auto [it, inserted] = cells.try_emplace(cell_of(positions[vertices[i]]), (uint32_t)clusters.size());
+		if (inserted)
+		{
+			clusters.emplace_back();
+		}
+
+		cluster_of[i] = it->second;
+		clusters[it->second].sum += positions[vertices[i]];
+		++clusters[it->second].count;
+	}
+
+	// the member closest to the mean stands for the cell
+	for (auto& cluster : clusters)
+	{
+		cluster.sum /= (float)cluster.count;
+	}
+
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		auto& cluster = clusters[cluster_of[i]];
+		const glm::vec3 delta = positions[vertices[i]] - cluster.sum;
+		const float distance2 = glm::dot(delta, delta);
+		if (distance2 < cluster.distance2)
+		{
+			cluster.distance2 = distance2;
+			cluster.representative = vertices[i];
+		}
+	}
+
+	error = 0.0f;
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		error = std::max(error, glm::length(positions[vertices[i]] - positions[clusters[cluster_of[i]].representative]));
+	}
+
+	// remapped triangles rotated so the smallest index comes first, which keeps the winding and lets sort find duplicates
+	std::vector<std::array<uint32_t, 3>> triangles;
+	triangles.reserve(indices.size() / 3);
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		std::array<uint32_t, 3> tri = {
+			clusters[cluster_of[slot_of(indices[i])]].representative,
+			clusters[cluster_of[slot_of(indices[i + 1])]].representative,
+			clusters[cluster_of[slot_of(indices[i + 2])]].representative
+		};
+
+		if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+		{
+			continue;
+		}
+
+		std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+		triangles.push_back(tri);
+	}
+
+	std::sort(triangles.begin(), triangles.end());
+	triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+	output.clear();
+	output.reserve(triangles.size() * 3);
+	for (const auto& tri : triangles)
+	{
+		output.insert(output.end(), tri.begin(), tri.end());
+	}
+
+	return true;
+}
+
+
+Utility::CacheStats Utility::analyzeVertexCache(const BasicMesh& mesh, size_t cache_size)
+{
+	CacheStats stats;
+	if (!validTriangles(mesh))
+	{
+		return stats;
+	}
+
+	std::vector<char> used(mesh.positions.size(), 0);
+	size_t used_count = 0;
+	for (const auto& index : mesh.indices)
+	{
+		used_count += used[index] ? 0 : 1;
+		used[index] = 1;
+	}
+
+	const size_t transformed = simulateVertexCache(mesh.indices, mesh.positions.size(), cache_size);
+	stats.acmr = (float)transformed / (float)(mesh.indices.size() / 3);
+	stats.atvr = (float)transformed / (float)used_count;
+	return stats;
+}
+
+bool Utility::optimizeVertexCache(BasicMesh& mesh, size_t cache_size)
+{
+	if (!validTriangles(mesh))
+	{
+		return false;
+	}
+
+	const uint32_t INVALID = UINT32_MAX;
+	const size_t vertex_count = mesh.positions.size();
+	const size_t triangle_count = mesh.indices.size() / 3;
+
+	// triangles around every vertex as compressed rows
+	std::vector<uint32_t> offsets(vertex_count + 1, 0);
+	for (const auto& index : mesh.indices)
+	{
+		++offsets[index + 1];
+	}
+
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+	std::vector<uint32_t> adjacency(mesh.indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < mesh.indices.size(); ++i)
+	{
+		adjacency[fill[mesh.indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	// triangles still to emit around every vertex
+	std::vector<uint32_t> live(vertex_count);
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		live[v] = offsets[v + 1] - offsets[v];
+	}
+
+	std::vector<size_t> cache_time(vertex_count, 0);
+	std::vector<char> emitted(triangle_count, 0);
+	std::vector<uint32_t> dead_end;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	dead_end.reserve(mesh.indices.size());
+	output.reserve(mesh.indices.size());
+
+	size_t time = cache_size + 1;
+	size_t cursor = 0;
+	uint32_t fanning = mesh.indices[0];
+
+	// Tipsify: emit every triangle around the fanning vertex, then continue from the one of its vertices
+	// that is most recently cached and still will be once its own remaining triangles are emitted
+	while (fanning != INVALID)
+	{
+		candidates.clear();
+		for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; ++k)
+		{
+			const uint32_t tri = adjacency[k];
+			if (emitted[tri])
+			{
+				continue;
+			}
+
+			for (int c = 0; c < 3; ++c)
+			{
+				const uint32_t v = mesh.indices[tri * 3 + c];
+				output.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+
+				if (time - cache_time[v] > cache_size)
+				{
+					cache_time[v] = time++;
+				}
+			}
+			emitted[tri] = 1;
+		}
+
+		uint32_t next = INVALID;
+		size_t best_priority = 0;
+		for (const auto& v : candidates)
+		{
+			if (live[v] == 0)
+			{
+				continue;
+			}
+
+			const size_t age = time - cache_time[v];
+			const size_t priority = age + 2 * live[v] <= cache_size ? age : 0;
+			if (next == INVALID || priority > best_priority)
+			{
+				next = v;
+				best_priority = priority;
+			}
+		}
+
+		// dead end, go back to recently used vertices with triangles left, then to the next one in input order
+		while (next == INVALID && !dead_end.empty())
+		{
+			if (live[dead_end.back()] > 0)
+			{
+				next = dead_end.back();
+			}
+			dead_end.pop_back();
+		}
+
+		for (; next == INVALID && cursor < vertex_count; ++cursor)
+		{
+			if (live[cursor] > 0)
+			{
+				next = (uint32_t)cursor;
+			}
+		}
+
+		fanning = next;
+	}
+
+	assert(output.size() == mesh.indices.size());
+	mesh.indices.swap(output);
+	return true;
+}
+
+bool Utility::optimizeOverdraw(BasicMesh& mesh, float threshold, size_t cache_size)
+{
+	if (!validTriangles(mesh))
+	{
+		return false;
+	}
+
+	const size_t triangle_count = mesh.indices.size() / 3;
+	std::vector<uint8_t> misses;
+	simulateVertexCache(mesh.indices, mesh.positions.size(), cache_size, &misses);
+
+	// a triangle missing all its vertices restarts the cache, reordering there costs nothing
+	std::vector<uint32_t> hard;
+	for (size_t tri = 0; tri < triangle_count; ++tri)
+	{
+		if (tri == 0 || misses[tri] == 3)
+		{
+			hard.push_back((uint32_t)tri);
+		}
+	}
+	hard.push_back((uint32_t)triangle_count);
+
+	// inside, a cluster ends once its cache ratio, counted from a cold cache since reordering moves it away from its
+	// predecessor, is within threshold of the one of the whole run
+	std::vector<size_t> cache_time(mesh.positions.size(), 0);
+	size_t time = cache_size + 1;
+
+	std::vector<uint32_t> starts;
+	for (size_t h = 0; h + 1 < hard.size(); ++h)
+	{
+		const size_t begin = hard[h], end = hard[h + 1];
+		size_t run_misses = 0;
+		for (size_t tri = begin; tri < end; ++tri)
+		{
+			run_misses += misses[tri];
+		}
+
+		const float target = threshold * (float)run_misses / (float)(end - begin);
+		size_t start = begin;
+		size_t cluster_misses = 0;
+		time += cache_size + 1;
+		starts.push_back((uint32_t)begin);
+		for (size_t tri = begin; tri + 1 < end; ++tri)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				const uint32_t v = mesh.indices[tri * 3 + c];
+				if (time - cache_time[v] > cache_size)
+				{
+					cache_time[v] = time++;
+					++cluster_misses;
+				}
+			}
+
+			if ((float)cluster_misses <= target * (float)(tri + 1 - start))
+			{
+				start = tri + 1;
+				cluster_misses = 0;
+				time += cache_size + 1;
+				starts.push_back((uint32_t)start);
+			}
+		}
+	}
+	starts.push_back((uint32_t)triangle_count);
+
+	auto corner = [&](size_t tri, int c) -> const glm::vec3& {
+		return mesh.positions[mesh.indices[tri * 3 + c]];
+	};
+
+	glm::vec3 weighted(0.0f);
+	float total_area = 0.0f;
+	for (size_t tri = 0; tri < triangle_count; ++tri)
+	{
+		const float area = glm::length(glm::cross(corner(tri, 1) - corner(tri, 0), corner(tri, 2) - corner(tri, 0)));
+		weighted += area * (corner(tri, 0) + corner(tri, 1) + corner(tri, 2));
+		total_area += area;
+	}
+	const glm::vec3 mesh_center = total_area > 0.0f ? weighted / (3.0f * total_area) : mesh.positions[0];
+
+	// clusters facing away from the center are in front of the rest from most view directions, they go first
+	const size_t cluster_count = starts.size() - 1;
+	std::vector<float> facing(cluster_count);
+	util::Parallel::forEach(cluster_count, [&](size_t i) {
+		glm::vec3 center(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t tri = starts[i]; tri < starts[i + 1]; ++tri)
+		{
+			const glm::vec3 cross = glm::cross(corner(tri, 1) - corner(tri, 0), corner(tri, 2) - corner(tri, 0));
+			const float length = glm::length(cross);
+			center += length * (corner(tri, 0) + corner(tri, 1) + corner(tri, 2));
+			normal += cross;
+			area += length;
+		}
+
+		const float length = glm::length(normal);
+		facing[i] = area > 0.0f && length > 0.0f ? glm::dot(center / (3.0f * area) - mesh_center, normal / length) : 0.0f;
+	}, 256);
+
+	std::vector<uint32_t> order(cluster_count);
+	std::iota(order.begin(), order.end(), 0u);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return facing[a] > facing[b];
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(mesh.indices.size());
+	for (const auto& cluster : order)
+	{
+		output.insert(output.end(), mesh.indices.begin() + starts[cluster] * 3, mesh.indices.begin() + starts[cluster + 1] * 3);
+	}
+
+	mesh.indices.swap(output);
+	return true;
+}
+
+bool Utility::optimizeVertexFetch(BasicMesh& mesh)
+{
+	if (!validTriangles(mesh) || !validStreams(mesh))
+	{
+		return false;
+	}
+
+	const uint32_t INVALID = UINT32_MAX;
+	std::vector<uint32_t> remap(mesh.positions.size(), INVALID);
+	uint32_t next = 0;
+	for (auto& index : mesh.indices)
+	{
+		if (remap[index] == INVALID)
+		{
+			remap[index] = next++;
+		}
+		index = remap[index];
+	}
+
+	remapStreams(mesh, remap, next);
+	return true;
+}
+
+bool Utility::optimizeMesh(BasicMesh& mesh, size_t cache_size)
+{
+	const CacheStats before = analyzeVertexCache(mesh, cache_size);
+	if (!optimizeVertexCache(mesh, cache_size) || !optimizeOverdraw(mesh, 1.05f, cache_size) || !optimizeVertexFetch(mesh))
+	{
+		return false;
+	}
+
+	const CacheStats after = analyzeVertexCache(mesh, cache_size);
+	SDL_Log("mesh optimize: %zu triangles, acmr %.3f -> %.3f, atvr %.3f -> %.3f",
+		mesh.indices.size() / 3, before.acmr, after.acmr, before.atvr, after.atvr);
+	return true;
+}
+
+bool Utility::weldVertices(BasicMesh& mesh, float epsilon)
+{
+	if (!validTriangles(mesh) || !validStreams(mesh))
+	{
+		return false;
+	}
+
+	const uint32_t INVALID = UINT32_MAX;
+	const size_t vertex_count = mesh.positions.size();
+	const double scale = epsilon > 0.0f ? 1.0 / epsilon : 0.0;
+
+	// attribute tuple of a vertex, cells of epsilon centered on its multiples or the exact bits with -0 folded into 0
+	const size_t KEY_SIZE = 18;
+	auto key_of = [&](size_t v, uint64_t (&key)[KEY_SIZE]) {
+		size_t n = 0;
+		auto push = [&](const float* values, int count) {
+			for (int i = 0; i < count; ++i)
+			{
+				if (scale > 0.0)
+				{
+					key[n++] = (uint64_t)(int64_t)std::floor(values[i] * scale + 0.5);
+				}
+				else
+				{
+					const float value = values[i] + 0.0f;
+					uint32_t bits;
+					std::memcpy(&bits, &value, sizeof(bits));
+					key[n++] = bits;
+				}
+			}
+		};
+
+		push(&mesh.positions[v].x, 3);
+		if (!mesh.texcoords.empty()) { push(&mesh.texcoords[v].x, 2); }
+		if (!mesh.normals.empty()) { push(&mesh.normals[v].x, 3); }
+		if (!mesh.tangents.empty()) { push(&mesh.tangents[v].x, 3); }
+		if (!mesh.bitangents.empty()) { push(&mesh.bitangents[v].x, 3); }
+		if (!mesh.colors.empty()) { push(&mesh.colors[v].x, 4); }
+		return n;
+	};
+
+	std::vector<uint64_t> hashes(vertex_count);
+	util::Parallel::forEach(vertex_count, [&](size_t v) {
+		uint64_t key[KEY_SIZE];
+		const size_t n = key_of(v, key);
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < n; ++i)
+		{
+			hash = (hash ^ key[i]) * 1099511628211ull;
+			hash ^= hash >> 29;
+		}
+		hashes[v] = hash;
+	});
+
+	// equal tuples end up next to each other, lowest vertex first
+	std::vector<uint32_t> order(vertex_count);
+	std::iota(order.begin(), order.end(), 0u);
+	std::sort(std::execution::par, order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : a < b;
+	});
+
+	// every vertex points at the lowest one with the same tuple, the hash runs are compared in full
+	std::vector<uint32_t> representative(vertex_count);
+	util::Parallel::forEachChunk(vertex_count, util::Parallel::chunkCount(vertex_count), [&](size_t, size_t begin, size_t end) {
+		// chunks start on the first vertex of a hash run
+		while (begin > 0 && begin < end && hashes[order[begin]] == hashes[order[begin - 1]])
+		{
+			++begin;
+		}
+
+		if (begin >= end)
+		{
+			return;
+		}
+
+		uint64_t key[KEY_SIZE], other[KEY_SIZE];
+		for (size_t i = begin; i < vertex_count && (i < end || hashes[order[i]] == hashes[order[i - 1]]); ++i)
+		{
+			const uint32_t v = order[i];
+			representative[v] = v;
+
+			const size_t n = key_of(v, key);
+			for (size_t j = i; j > 0 && hashes[order[j - 1]] == hashes[v]; --j)
+			{
+				const uint32_t u = order[j - 1];
+				if (representative[u] == u && key_of(u, other) == n && std::equal(key, key + n, other))
+				{
+					representative[v] = u;
+					break;
+				}
+			}
+		}
+	});
+
+	// kept vertices stay in their order
+	std::vector<uint32_t> remap(vertex_count);
+	std::vector<uint32_t> kept(vertex_count, INVALID);
+	uint32_t next = 0;
+	for (size_t v = 0; v < vertex_count; ++v)
+	{
+		if (representative[v] == v)
+		{
+			kept[v] = remap[v] = next++;
+		}
+		else
+		{
+			remap[v] = remap[representative[v]];
+		}
+	}
+
+	util::Parallel::forEach(mesh.indices.size(), [&](size_t i) {
+		mesh.indices[i] = remap[mesh.indices[i]];
+	});
+
+	// corners welded together leave triangles without area
+	size_t written = 0;
+	for (size_t i = 0; i < mesh.indices.size(); i += 3)
+	{
+		const uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+		if (a != b && b != c && a != c)
+		{
+			mesh.indices[written++] = a;
+			mesh.indices[written++] = b;
+			mesh.indices[written++] = c;
+		}
+	}
+	mesh.indices.resize(written);
+
+	SDL_Log("mesh weld: %zu -> %u vertices", vertex_count, next);
+	remapStreams(mesh, kept, next);
+	return true;
+}
+
+bool Utility::narrowIndices(std::span<const uint32_t> indices, std::vector<uint16_t>& output)
+{
+	output.resize(indices.size());
+
+	std::atomic<bool> fits = true;
+	util::Parallel::forEach(indices.size(), [&](size_t i) {
+		if (indices[i] > UINT16_MAX)
+		{
+			fits.store(false, std::memory_order_relaxed);
+		}
+		output[i] = (uint16_t)indices[i];
+	});
+
+	if (!fits)
+	{
+		output.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool Utility::buildMeshlets(const BasicMesh& mesh, MeshletMesh& output, size_t max_vertices, size_t max_triangles)
+{
+	if (!validTriangles(mesh))
+	{
+		return false;
+	}
+
+	if (max_vertices < 3 || max_vertices > 255 || max_triangles < 1)
+	{
+		SDL_Log("invalid meshlet limits, max_vertices must be in [3, 255] and max_triangles positive");
+		return false;
+	}
+
+	const uint8_t UNUSED = 0xff;
+	output.meshlets.clear();
+	output.vertices.clear();
+	output.triangles.clear();
+
+	// meshlet vertex of every mesh vertex while its meshlet is filled
+	std::vector<uint8_t> local(mesh.positions.size(), UNUSED);
+	Meshlet current;
+
+	auto flush = [&]() {
+		if (current.triangle_count == 0)
+		{
+			return;
+		}
+
+		for (size_t i = current.vertex_offset; i < output.vertices.size(); ++i)
+		{
+			local[output.vertices[i]] = UNUSED;
+		}
+
+		output.triangles.resize((output.triangles.size() + 3) & ~size_t(3), 0);
+		output.meshlets.push_back(current);
+
+		current = Meshlet();
+		current.vertex_offset = (uint32_t)output.vertices.size();
+		current.triangle_offset = (uint32_t)output.triangles.size();
+	};
+
+	for (size_t i = 0; i < mesh.indices.size(); i += 3)
+	{
+		const uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+		const uint32_t added = (local[a] == UNUSED) + (local[b] == UNUSED && b != a) + (local[c] == UNUSED && c != a && c != b);
+		if (current.vertex_count + added > max_vertices || current.triangle_count + 1 > max_triangles)
+		{
+			flush();
+		}
+
+		for (const uint32_t v : { a, b, c })
+		{
+			if (local[v] == UNUSED)
+			{
+				local[v] = (uint8_t)current.vertex_count++;
+				output.vertices.push_back(v);
+			}
+			output.triangles.push_back(local[v]);
+		}
+		++current.triangle_count;
+	}
+	flush();
+
+	// bounds and cones are independent per meshlet
+	util::Parallel::forEach(output.meshlets.size(), [&](size_t m) {
+		auto& meshlet = output.meshlets[m];
+		const uint32_t* vertices = output.vertices.data() + meshlet.vertex_offset;
+		const uint8_t* triangles = output.triangles.data() + meshlet.triangle_offset;
+
+		glm::vec3 min(std::numeric_limits<float>::max());
+		glm::vec3 max(std::numeric_limits<float>::lowest());
+		for (uint32_t v = 0; v < meshlet.vertex_count; ++v)
+		{
+			min = glm::min(min, mesh.positions[vertices[v]]);
+			max = glm::max(max, mesh.positions[vertices[v]]);
+		}
+
+		const glm::vec3 center = (min + max) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t v = 0; v < meshlet.vertex_count; ++v)
+		{
+			radius = std::max(radius, glm::length(mesh.positions[vertices[v]] - center));
+		}
+		meshlet.sphere = glm::vec4(center, radius);
+
+		// axis is the mean unit normal, the half angle reaches the normal farthest from it
+		auto unit_normal = [&](uint32_t t) {
+			const glm::vec3& p0 = mesh.positions[vertices[triangles[t * 3 + 0]]];
+			const glm::vec3& p1 = mesh.positions[vertices[triangles[t * 3 + 1]]];
+			const glm::vec3& p2 = mesh.positions[vertices[triangles[t * 3 + 2]]];
+			const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float length = glm::length(normal);
+			return length > 0.0f ? normal / length : glm::vec3(0.0f);
+		};
+
+		glm::vec3 axis(0.0f);
+		for (uint32_t t = 0; t < meshlet.triangle_count; ++t)
+		{
+			axis += unit_normal(t);
+		}
+
+		const float axis_length = glm::length(axis);
+		if (axis_length <= 0.0f)
+		{
+			return;
+		}
+
+		axis /= axis_length;
+		float min_dot = 1.0f;
+		for (uint32_t t = 0; t < meshlet.triangle_count; ++t)
+		{
+			const glm::vec3 normal = unit_normal(t);
+			if (normal != glm::vec3(0.0f))
+			{
+				min_dot = std::min(min_dot, glm::dot(normal, axis));
+			}
+		}
+
+		// cones of 90 degrees and wider always have a front facing normal
+		meshlet.cone = min_dot > 0.0f ? glm::vec4(axis, std::sqrt(std::max(0.0f, 1.0f - min_dot * min_dot))) : glm::vec4(axis, 1.0f);
+	}, 64);
+
+	return true;
+}
+
+bool Utility::simplify(const BasicMesh& mesh, float target_ratio, float max_error, std::vector<uint32_t>& output, float& error)
+{
+	if (!validTriangles(mesh) || !validStreams(mesh))
+	{
+		return false;
+	}
+
+	Simplifier simplifier(mesh);
+	simplifier.run((size_t)(mesh.indices.size() / 3 * std::clamp(target_ratio, 0.0f, 1.0f)), max_error);
+	simplifier.indices(output);
+	error = simplifier.error();
+	return true;
+}
+
+bool Utility::buildLods(const BasicMesh& mesh, size_t levels, float ratio, float max_error, std::vector<MeshLod>& output)
+{
+	output.clear();
+	if (!validTriangles(mesh) || !validStreams(mesh))
+	{
+		return false;
+	}
+
+	// one collapse sequence, every level is a snapshot of it, so the errors are measured against the full mesh
+	Simplifier simplifier(mesh);
+	size_t target = mesh.indices.size() / 3;
+	for (size_t level = 0; level < levels; ++level)
+	{
+		const size_t before = simplifier.triangleCount();
+		target = (size_t)(target * std::clamp(ratio, 0.0f, 1.0f));
+		const bool reached = simplifier.run(target, max_error);
+
+		// a level barely smaller than the previous one is not worth its indices
+		if (simplifier.triangleCount() == 0 || simplifier.triangleCount() > before * 0.9)
+		{
+			break;
+		}
+
+		MeshLod lod;
+		simplifier.indices(lod.indices);
+		lod.error = simplifier.error();
+		output.push_back(std::move(lod));
+
+		if (!reached)
+		{
+			break;
+		}
 	}
 
 	return true;
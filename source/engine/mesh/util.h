@@ -1,5 +1,7 @@
 #pragma once
 #include "basic_mesh.h"
+#include "meshlet.h"
+#include <span>
 
 namespace mesh
 {
@@ -10,10 +12,58 @@ public:
 	Utility();
 	~Utility();
 
-	static bool computeNormals(BasicMesh& mesh_input_output, bool force_replace_old_normals = false);
+	enum NormalWeight
+	{
+		NORMAL_WEIGHT_AREA,  // face normals weighted by triangle area
+		NORMAL_WEIGHT_ANGLE  // face normals weighted by the corner angle, independent of the tessellation
+	};
+
+	// smooth vertex normals from the weighted face normals of the triangles around each vertex.
+	// triangles are spread over worker threads, vertices without a valid triangle get a zero normal.
+	static bool computeNormals(BasicMesh& mesh_input_output, bool force_replace_old_normals = false, NormalWeight weight = NORMAL_WEIGHT_AREA);
 	static bool createVertexArray(const BasicMesh& mesh_input, std::vector<Vertex>& output);
+	// MikkTSpace compatible tangents and bitangents from the texture coordinates, triangles are spread over worker threads.
+	// normals are computed first when missing. vertices shared by mirrored and regular uv islands are not split.
 	static bool computeTangents(BasicMesh& mesh_input_output, bool force_replace_old_tangents = false);
 	static bool transformPointCloud(BasicMesh& mesh_input_output, const glm::mat4& matrix);
+	// vertex clustering simplification of the triangles in indices. vertices are snapped to a grid of cell_size starting
+	// at grid_min, every cell keeps the vertex closest to the mean of its members. output indexes the unchanged positions,
+	// collapsed and duplicate triangles are dropped. error is the farthest any vertex moved.
+	static bool clusterVertices(const std::vector<Position>& positions, std::span<const uint32_t> indices, const glm::vec3& grid_min, float cell_size,
+		std::vector<uint32_t>& output, float& error);
+
+	// post transform vertex cache statistics for a FIFO cache of cache_size entries. acmr is the transformed vertices
+	// per triangle, 0.5 at best, atvr the transformed vertices per referenced vertex, 1 at best.
+	struct CacheStats
+	{
+		float acmr = 0.0f;
+		float atvr = 0.0f;
+	};
+	static CacheStats analyzeVertexCache(const BasicMesh& mesh_input, size_t cache_size = 16);
+	// Tipsify triangle order for a vertex cache of cache_size entries, linear in the triangle count
+	static bool optimizeVertexCache(BasicMesh& mesh_input_output, size_t cache_size = 16);
+	// splits cache ordered triangles into clusters where the cache ratio stays within threshold of the original and draws
+	// the clusters facing away from the mesh center first, so they occlude the others from most view directions
+	static bool optimizeOverdraw(BasicMesh& mesh_input_output, float threshold = 1.05f, size_t cache_size = 16);
+	// numbers vertices in the order the indices first use them and moves every stream along, unused vertices are dropped
+	static bool optimizeVertexFetch(BasicMesh& mesh_input_output);
+	// the three passes above in order, logs the cache statistics before and after
+	static bool optimizeMesh(BasicMesh& mesh_input_output, size_t cache_size = 16);
+	// merges vertices with equal attribute tuples and rewrites the indices, triangles losing their area are dropped.
+	// epsilon 0 compares the exact values, otherwise every attribute is snapped to cells of epsilon first.
+	static bool weldVertices(BasicMesh& mesh_input_output, float epsilon = 0.0f);
+	// 16 bit copy of indices, fails when an index does not fit
+	static bool narrowIndices(std::span<const uint32_t> indices, std::vector<uint16_t>& output);
+	// splits the triangles, in their order, into meshlets of at most max_vertices and max_triangles with a bounding sphere
+	// and normal cone each. run optimizeVertexCache first, neighbouring triangles then fill a meshlet. max_vertices <= 255.
+	static bool buildMeshlets(const BasicMesh& mesh_input, MeshletMesh& output, size_t max_vertices = 64, size_t max_triangles = 124);
+	// quadric error edge collapse, respecting normals and uvs, until target_ratio of the triangles remain or the next collapse
+	// would deviate more than max_error. vertices are not moved, output indexes the vertices of the mesh. seam and border
+	// vertices stay. error is the deviation reached, in mesh units.
+	static bool simplify(const BasicMesh& mesh_input, float target_ratio, float max_error, std::vector<uint32_t>& output, float& error);
+	// up to levels LODs, each keeping ratio of the triangles of the one before, stops early at max_error.
+	// errors are measured against the full mesh, for picking a level by its projected size.
+	static bool buildLods(const BasicMesh& mesh_input, size_t levels, float ratio, float max_error, std::vector<MeshLod>& output);
 
 };
 
@@ -0,0 +1,389 @@
+#pragma once
+#include "basic_mesh.h"
+#include "../util/parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <SDL2/SDL.h>
+#include <vulkan/vulkan.hpp>
+
+namespace mesh
+{
+
+// attribute streams of BasicMesh a vertex layout can pick from. the float forms upload the stream as is,
+// the others are quantized on interleave and decoded by the vertex shader.
+enum class Attribute
+{
+	POSITION,
+	NORMAL,
+	TANGENT,
+	BITANGENT,
+	COLOR,
+	UV,
+	POSITION_UNORM16,  // 16 bits per axis relative to the mesh bounds, decoded as min + value * extent
+	NORMAL_OCT16,      // octahedral unit vector in two snorm16
+	TANGENT_OCT16,
+	BITANGENT_OCT16,
+	COLOR_UNORM8,
+	UV_HALF
+};
+
+// box the quantized positions of one mesh are relative to, handed to the shader per draw
+struct VertexBounds
+{
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 extent = glm::vec3(1.0f);
+};
+
+// QUANTIZATION
+inline uint16_t packUnorm16(float value)
+{
+	return (uint16_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+inline int16_t packSnorm16(float value)
+{
+	return (int16_t)std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+inline uint8_t packUnorm8(float value)
+{
+	return (uint8_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+}
+
+// IEEE half, rounded to nearest even. overflow gives infinity, tiny values become subnormals or zero.
+inline uint16_t packHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const uint32_t sign = (bits >> 16) & 0x8000u;
+	const uint32_t abs = bits & 0x7fffffffu;
+
+	if (abs >= 0x7f800000u)
+	{
+		return (uint16_t)(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u)); // inf, nan
+	}
+
+	if (abs >= 0x477ff000u)
+	{
+		return (uint16_t)(sign | 0x7c00u); // rounds past 65504
+	}
+
+	if (abs < 0x38800000u)
+	{
+		// below the smallest normal half, the mantissa is shifted into a subnormal
+		if (abs < 0x33000000u)
+		{
+			return (uint16_t)sign;
+		}
+
+		const uint32_t mantissa = (abs & 0x7fffffu) | 0x800000u;
+		const uint32_t shift = 126u - (abs >> 23);
+		uint32_t half = mantissa >> shift;
+		const uint32_t rest = mantissa & ((1u << shift) - 1u);
+		const uint32_t middle = 1u << (shift - 1u);
+		if (rest > middle || (rest == middle && (half & 1u)))
+		{
+			++half;
+		}
+		return (uint16_t)(sign | half);
+	}
+
+	// rebias the exponent from 127 to 15 and drop 13 mantissa bits, a carry moves into the exponent
+	uint32_t half = (abs - 0x38000000u) >> 13;
+	const uint32_t rest = abs & 0x1fffu;
+	if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+	{
+		++half;
+	}
+	return (uint16_t)(sign | half);
+}
+
+// unit vector on the octahedron |x| + |y| + |z| = 1, the lower half folded over the diagonals into [-1, 1]^2
+inline glm::vec2 octahedralEncode(const glm::vec3& v)
+{
+	const float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+	if (l1 <= 0.0f)
+	{
+		return glm::vec2(0.0f);
+	}
+
+	glm::vec2 p = glm::vec2(v.x, v.y) / l1;
+	if (v.z < 0.0f)
+	{
+		p = glm::vec2((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+	}
+	return p;
+}
+
+inline glm::vec3 octahedralDecode(const glm::vec2& p)
+{
+	glm::vec3 v(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+	if (v.z < 0.0f)
+	{
+		v = glm::vec3((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f), v.z);
+	}
+	return glm::normalize(v);
+}
+
+// stored type, vulkan format, source stream, the value used when the stream is empty and the encoding.
+// fallbacks match the defaults of mesh::Vertex. BOUNDED attributes need the mesh bounds.
+template <Attribute A>
+struct AttributeTraits;
+
+template <class T, vk::Format F>
+struct FloatAttribute
+{
+	using Source = T;
+	using Type = T;
+	static constexpr vk::Format FORMAT = F;
+	static constexpr bool BOUNDED = false;
+	static Type encode(const Source& value, const VertexBounds&) { return value; }
+};
+
+struct OctahedralAttribute
+{
+	using Source = glm::vec3;
+	using Type = std::array<int16_t, 2>;
+	static constexpr vk::Format FORMAT = vk::Format::eR16G16Snorm;
+	static constexpr bool BOUNDED = false;
+	static Type encode(const Source& value, const VertexBounds&)
+	{
+		const glm::vec2 p = octahedralEncode(value);
+		return { packSnorm16(p.x), packSnorm16(p.y) };
+	}
+	static Source fallback() { return Source(0.0f); }
+};
+
+template <>
+struct AttributeTraits<Attribute::POSITION> : FloatAttribute<Position, vk::Format::eR32G32B32Sfloat>
+{
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.positions; }
+	static Source fallback() { return Source(0.0f); }
+};
+
+template <>
+struct AttributeTraits<Attribute::NORMAL> : FloatAttribute<Normal, vk::Format::eR32G32B32Sfloat>
+{
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.normals; }
+	static Source fallback() { return Source(0.0f); }
+};
+
+template <>
+struct AttributeTraits<Attribute::TANGENT> : FloatAttribute<Tangent, vk::Format::eR32G32B32Sfloat>
+{
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.tangents; }
+	static Source fallback() { return Source(0.0f); }
+};
+
+template <>
+struct AttributeTraits<Attribute::BITANGENT> : FloatAttribute<BiTangent, vk::Format::eR32G32B32Sfloat>
+{
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.bitangents; }
+	static Source fallback() { return Source(0.0f); }
+};
+
+template <>
+struct AttributeTraits<Attribute::COLOR> : FloatAttribute<Color, vk::Format::eR32G32B32A32Sfloat>
+{
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.colors; }
+	static Source fallback() { return Source(0.0f, 0.0f, 0.0f, 1.0f); }
+};
+
+template <>
+struct AttributeTraits<Attribute::UV> : FloatAttribute<UV, vk::Format::eR32G32Sfloat>
+{
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.texcoords; }
+	static Source fallback() { return Source(0.0f); }
+};
+
+template <>
+struct AttributeTraits<Attribute::POSITION_UNORM16>
+{
+	using Source = Position;
+	using Type = std::array<uint16_t, 4>; // w pads to 8 bytes
+	static constexpr vk::Format FORMAT = vk::Format::eR16G16B16A16Unorm;
+	static constexpr bool BOUNDED = true;
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.positions; }
+	static Source fallback() { return Source(0.0f); }
+	static Type encode(const Source& value, const VertexBounds& bounds)
+	{
+		const glm::vec3 scale = glm::vec3(
+			bounds.extent.x > 0.0f ? 1.0f / bounds.extent.x : 0.0f,
+			bounds.extent.y > 0.0f ? 1.0f / bounds.extent.y : 0.0f,
+			bounds.extent.z > 0.0f ? 1.0f / bounds.extent.z : 0.0f);
+		const glm::vec3 unit = (value - bounds.min) * scale;
+		return { packUnorm16(unit.x), packUnorm16(unit.y), packUnorm16(unit.z), 0 };
+	}
+};
+
+template <>
+struct AttributeTraits<Attribute::NORMAL_OCT16> : OctahedralAttribute
+{
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.normals; }
+};
+
+template <>
+struct AttributeTraits<Attribute::TANGENT_OCT16> : OctahedralAttribute
+{
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.tangents; }
+};
+
+template <>
+struct AttributeTraits<Attribute::BITANGENT_OCT16> : OctahedralAttribute
+{
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.bitangents; }
+};
+
+template <>
+struct AttributeTraits<Attribute::COLOR_UNORM8>
+{
+	using Source = Color;
+	using Type = std::array<uint8_t, 4>;
+	static constexpr vk::Format FORMAT = vk::Format::eR8G8B8A8Unorm;
+	static constexpr bool BOUNDED = false;
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.colors; }
+	static Source fallback() { return Source(0.0f, 0.0f, 0.0f, 1.0f); }
+	static Type encode(const Source& value, const VertexBounds&)
+	{
+		return { packUnorm8(value.x), packUnorm8(value.y), packUnorm8(value.z), packUnorm8(value.w) };
+	}
+};
+
+template <>
+struct AttributeTraits<Attribute::UV_HALF>
+{
+	using Source = UV;
+	using Type = std::array<uint16_t, 2>;
+	static constexpr vk::Format FORMAT = vk::Format::eR16G16Sfloat;
+	static constexpr bool BOUNDED = false;
+	static const std::vector<Source>& stream(const BasicMesh& mesh) { return mesh.texcoords; }
+	static Source fallback() { return Source(0.0f); }
+	static Type encode(const Source& value, const VertexBounds&)
+	{
+		return { packHalf(value.x), packHalf(value.y) };
+	}
+};
+
+// interleaved vertex format declared once as a list of attributes. the list order is the memory order
+// and the shader location order, so the vertex data and the pipeline input state cannot drift apart.
+//
+//   using ModelVertex = mesh::VertexLayout<mesh::Attribute::POSITION, mesh::Attribute::NORMAL, mesh::Attribute::COLOR>;
+//   std::vector<ModelVertex::Vertex> vertices;
+//   ModelVertex::interleave(mesh, vertices);
+//   auto attributes = ModelVertex::attributes(0);
+template <Attribute... As>
+class VertexLayout
+{
+public:
+	static_assert(sizeof...(As) > 0, "a vertex layout needs at least one attribute");
+
+	static constexpr size_t COUNT = sizeof...(As);
+	static constexpr uint32_t STRIDE = (uint32_t(sizeof(typename AttributeTraits<As>::Type)) + ...);
+	static constexpr std::array<uint32_t, COUNT> OFFSETS = []() {
+		const uint32_t sizes[] = { uint32_t(sizeof(typename AttributeTraits<As>::Type))... };
+		std::array<uint32_t, COUNT> offsets = {};
+		for (size_t i = 1; i < COUNT; ++i)
+		{
+			offsets[i] = offsets[i - 1] + sizes[i - 1];
+		}
+		return offsets;
+	}();
+
+	// one packed vertex, sizeof(Vertex) == STRIDE
+	struct alignas(4) Vertex
+	{
+		uint8_t bytes[STRIDE];
+	};
+	static_assert(sizeof(Vertex) == STRIDE, "attributes are 4 byte multiples, no padding");
+
+	// position bounds are only taken when an attribute is stored relative to them
+	static constexpr bool BOUNDED = (AttributeTraits<As>::BOUNDED || ...);
+
+	// fills output with one vertex per position, empty streams are written with their fallback.
+	// bounds receives the box quantized positions are relative to, the identity box for BOUNDED == false.
+	static bool interleave(const BasicMesh& mesh, std::vector<Vertex>& output, VertexBounds* bounds = nullptr)
+	{
+		if (mesh.indices.empty() || mesh.positions.empty())
+		{
+			SDL_Log("invalid mesh input, postions or indices are empty");
+			return false;
+		}
+
+		if (((!AttributeTraits<As>::stream(mesh).empty() && AttributeTraits<As>::stream(mesh).size() != mesh.positions.size()) || ...))
+		{
+			SDL_Log("invalid mesh input, attribute streams and positions differ in size");
+			return false;
+		}
+
+		VertexBounds box;
+		if constexpr (BOUNDED)
+		{
+			glm::vec3 min(std::numeric_limits<float>::max());
+			glm::vec3 max(std::numeric_limits<float>::lowest());
+			for (const auto& pt : mesh.positions)
+			{
+				min = glm::min(min, pt);
+				max = glm::max(max, pt);
+			}
+			box.min = min;
+			box.extent = max - min;
+		}
+
+		if (bounds)
+		{
+			*bounds = box;
+		}
+
+		output.resize(mesh.positions.size());
+		util::Parallel::forEach(output.size(), [&](size_t i) {
+			writeVertex(mesh, i, box, output[i], std::make_index_sequence<COUNT>());
+		});
+
+		return true;
+	}
+
+	static vk::VertexInputBindingDescription binding(uint32_t binding = 0)
+	{
+		return vk::VertexInputBindingDescription(binding, STRIDE, vk::VertexInputRate::eVertex);
+	}
+
+	// one description per attribute, locations counted up from first_location in list order
+	static std::vector<vk::VertexInputAttributeDescription> attributes(uint32_t binding = 0, uint32_t first_location = 0)
+	{
+		const vk::Format formats[] = { AttributeTraits<As>::FORMAT... };
+
+		std::vector<vk::VertexInputAttributeDescription> result(COUNT);
+		for (size_t i = 0; i < COUNT; ++i)
+		{
+			result[i].binding = binding;
+			result[i].location = first_location + (uint32_t)i;
+			result[i].format = formats[i];
+			result[i].offset = OFFSETS[i];
+		}
+		return result;
+	}
+
+private:
+	template <size_t... I>
+	static void writeVertex(const BasicMesh& mesh, size_t index, const VertexBounds& bounds, Vertex& out, std::index_sequence<I...>)
+	{
+		(writeAttribute<As>(mesh, index, bounds, out.bytes + OFFSETS[I]), ...);
+	}
+
+	template <Attribute A>
+	static void writeAttribute(const BasicMesh& mesh, size_t index, const VertexBounds& bounds, uint8_t* dst)
+	{
+		using Traits = AttributeTraits<A>;
+		const auto& stream = Traits::stream(mesh);
+		const typename Traits::Type value = Traits::encode(stream.empty() ? Traits::fallback() : stream[index], bounds);
+		std::memcpy(dst, &value, sizeof(value));
+	}
+};
+
+} // end namespace mesh
@@ -0,0 +1,226 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <assert.h>
+
+namespace octree
+{
+
+// Element storage shared by every node of a LinearOctree.
+// A node owns the block [first, first + capacity) of the slot range and uses its first count slots.
+// build() hands over a packed array (capacity == count per leaf) that becomes the base of the range.
+// Incremental inserts allocate power of two blocks from fixed size chunks appended after the base,
+// so allocating never moves an element that is already stored. Freed blocks are split into power of two
+// pieces kept on a free list per size class and reused.
+// A pool can also be attached to external memory (a mapped file), it is then read only in size.
+template <class T>
+class LeafPool
+{
+public:
+	// slots per chunk, blocks of this size or larger get consecutive chunks of their own
+	static constexpr uint32_t CHUNK_SHIFT = 12;
+	static constexpr uint32_t CHUNK_SLOTS = uint32_t(1) << CHUNK_SHIFT;
+
+	// moves the count used elements of a block into a new block of at least min_capacity,
+	// frees the old one and returns the new first slot through first / capacity
+	void grow(uint32_t& first, uint32_t count, uint32_t& capacity, uint32_t min_capacity)
+	{
+		assert(!d_external);
+
+		uint32_t size_class = 0;
+		while ((uint32_t(1) << size_class) < min_capacity)
+		{
+			++size_class;
+		}
+
+		const uint32_t new_first = allocate(size_class);
+		T* from = slot(first);
+		T* to = slot(new_first);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			to[i] = std::move(from[i]);
+		}
+
+		release(first, capacity);
+		first = new_first;
+		capacity = uint32_t(1) << size_class;
+	}
+
+	// returns a block to the pool. packed blocks of any size are split into power of two pieces,
+	// so every slot of them is reused.
+	void release(uint32_t first, uint32_t capacity)
+	{
+		for (uint32_t size_class = 32; capacity && size_class-- > 0;)
+		{
+			const uint32_t piece = uint32_t(1) << size_class;
+			if (capacity & piece)
+			{
+				push_free(size_class, first);
+				first += piece;
+				capacity -= piece;
+			}
+		}
+	}
+
+	// replaces the content with a packed array, the caller owns the block layout
+	void assign(std::vector<T>&& items)
+	{
+		clear();
+		d_items = std::move(items);
+	}
+
+	// uses count elements at items as the pool content, the memory stays owned by the caller
+	void attach(T* items, size_t count)
+	{
+		clear();
+		d_external = items;
+		d_external_count = count;
+	}
+
+	// drops every block and gives the memory back
+	void clear()
+	{
+		d_external = nullptr;
+		d_external_count = 0;
+		std::vector<T>().swap(d_items);
+		std::vector<std::unique_ptr<T[]>>().swap(d_chunk_memory);
+		std::vector<T*>().swap(d_chunks);
+		d_bump_first = 0;
+		d_bump_used = CHUNK_SLOTS;
+		std::vector<std::vector<uint32_t>>().swap(d_free);
+		d_free_slots = 0;
+	}
+
+	std::span<T> view(uint32_t first, uint32_t count)
+	{
+		assert((size_t)first + count <= size());
+		return std::span<T>(count ? slot(first) : nullptr, count);
+	}
+
+	std::span<const T> view(uint32_t first, uint32_t count) const
+	{
+		assert((size_t)first + count <= size());
+		return std::span<const T>(count ? slot(first) : nullptr, count);
+	}
+
+	T& operator[](uint32_t index)
+	{
+		return *slot(index);
+	}
+
+	// slots allocated so far, used or not
+	size_t size() const
+	{
+		return base_size() + d_chunks.size() * CHUNK_SLOTS;
+	}
+
+	// slots sitting in freed blocks
+	size_t free_slots() const
+	{
+		return d_free_slots;
+	}
+
+	size_t memory_bytes() const
+	{
+		size_t bytes = d_items.capacity() * sizeof(T) + d_chunks.size() * (CHUNK_SLOTS * sizeof(T) + sizeof(T*));
+		for (const auto& list : d_free)
+		{
+			bytes += list.capacity() * sizeof(uint32_t);
+		}
+		return bytes + d_external_count * sizeof(T);
+	}
+
+private:
+	std::vector<T> d_items;                           // packed base from assign
+	std::vector<std::unique_ptr<T[]>> d_chunk_memory; // one allocation per chunk or per large block
+	std::vector<T*> d_chunks;                         // start of every CHUNK_SLOTS slots after the base
+	uint32_t d_bump_first = 0;                        // first slot of the chunk small blocks are cut from
+	uint32_t d_bump_used = CHUNK_SLOTS;               // slots handed out from it
+	std::vector<std::vector<uint32_t>> d_free;        // first slot of the freed blocks, per log2(capacity)
+	size_t d_free_slots = 0;
+	T* d_external = nullptr;
+	size_t d_external_count = 0;
+
+	size_t base_size() const
+	{
+		return d_external ? d_external_count : d_items.size();
+	}
+
+	T* slot(uint32_t index)
+	{
+		return const_cast<T*>(static_cast<const LeafPool*>(this)->slot(index));
+	}
+
+	const T* slot(uint32_t index) const
+	{
+		const size_t base = base_size();
+		if (index < base)
+		{
+			return (d_external ? d_external : d_items.data()) + index;
+		}
+
+		const size_t offset = index - base;
+		return d_chunks[offset >> CHUNK_SHIFT] + (offset & (CHUNK_SLOTS - 1));
+	}
+
+	void push_free(uint32_t size_class, uint32_t first)
+	{
+		if (d_free.size() <= size_class)
+		{
+			d_free.resize(size_class + 1);
+		}
+		d_free[size_class].push_back(first);
+		d_free_slots += uint32_t(1) << size_class;
+	}
+
+	// appends count consecutive chunks backed by one allocation and returns the first slot of it
+	uint32_t add_chunks(size_t count)
+	{
+		assert(size() + count * CHUNK_SLOTS <= UINT32_MAX);
+		const uint32_t first = (uint32_t)size();
+
+		d_chunk_memory.push_back(std::make_unique<T[]>(count * CHUNK_SLOTS));
+		for (size_t i = 0; i < count; ++i)
+		{
+			d_chunks.push_back(d_chunk_memory.back().get() + i * CHUNK_SLOTS);
+		}
+		return first;
+	}
+
+	uint32_t allocate(uint32_t size_class)
+	{
+		assert(!d_external);
+		const uint32_t capacity = uint32_t(1) << size_class;
+
+		if (size_class < d_free.size() && !d_free[size_class].empty())
+		{
+			const uint32_t first = d_free[size_class].back();
+			d_free[size_class].pop_back();
+			d_free_slots -= capacity;
+			return first;
+		}
+
+		if (capacity >= CHUNK_SLOTS)
+		{
+			return add_chunks(capacity >> CHUNK_SHIFT);
+		}
+
+		if (d_bump_used + capacity > CHUNK_SLOTS)
+		{
+			// the tail of the current chunk is too small, keep it for smaller blocks
+			release(d_bump_first + d_bump_used, CHUNK_SLOTS - d_bump_used);
+			d_bump_first = add_chunks(1);
+			d_bump_used = 0;
+		}
+
+		const uint32_t first = d_bump_first + d_bump_used;
+		d_bump_used += capacity;
+		return first;
+	}
+};
+
+}// end namespace octree
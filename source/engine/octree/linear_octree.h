@@ -3,298 +3,1699 @@
 #include <vector>
 #include <unordered_map>
 #include <functional>
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <queue>
+#include <type_traits>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <mutex>
 #include <glm/glm.hpp>
-#include <bitset>
 #include <assert.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #include "../vkapi/data_type.h"
+#include "node_storage.h"
+#include "leaf_pool.h"
+#include "morton.h"
+#include "spatial_query.h"
+#include "../camera/free_camera.h"
+#include "../camera/frustum.h"
+#include "../util/mapped_file.h"
+
+namespace octree
+{
+
+enum LOctant
+{
+	DN_LEVEL_BACK_LEFT = 0,
+	DN_LEVEL_BACK_RIGHT,
+	DN_LEVEL_FRONT_LEFT,
+	DN_LEVEL_FRONT_RIGHT,
+	UP_LEVEL_BACK_LEFT,
+	UP_LEVEL_BACK_RIGHT,
+	UP_LEVEL_FRONT_LEFT,
+	UP_LEVEL_FRONT_RIGHT,
+	OCTANT_SIZE
+};
+
+// face directions, in LOctant terms x goes left to right, y down to up and z back to front
+enum LDirection
+{
+	DIRECTION_LEFT = 0,
+	DIRECTION_RIGHT,
+	DIRECTION_DOWN,
+	DIRECTION_UP,
+	DIRECTION_BACK,
+	DIRECTION_FRONT,
+	DIRECTION_SIZE
+};
+
+// Code is the locational code type, uint32_t allows 10 levels and uint64_t 21 levels
+// the elements of a node live in the LeafPool of its tree, see LinearOctree::node_data
+template <class T, class Code = uint32_t>
+struct LOctantNode
+{
+	Code     locCode = 0;
+	uint8_t  childrenFlags = 0;
+	uint8_t  reserved[3] = {}; // the padding before first, spelled out so saved nodes are deterministic bytes
+	uint32_t first = 0;    // first slot of the payload block
+	uint32_t count = 0;    // elements stored
+	uint32_t capacity = 0; // slots owned, 0 when the node holds no block
+};
+
+
+// on disk layout written by LinearOctree::save, native byte order:
+// header | nodes sorted by locCode | payload, packed leaf after leaf in node order.
+// sections start on FILE_ALIGNMENT boundaries so a mapped file is used in place.
+struct OctreeFileHeader
+{
+	char     magic[4];
+	uint32_t version;
+	uint32_t code_size;
+	uint32_t node_size;
+	uint32_t element_size;
+	uint32_t max_depth;
+	uint32_t max_element_per_node;
+	float    min[3];
+	float    side_length;
+	float    looseness;
+	uint64_t node_count;
+	uint64_t node_offset;
+	uint64_t element_count;
+	uint64_t element_offset;
+
+	static constexpr char MAGIC[4] = { 'L', 'O', 'C', 'T' };
+	static constexpr uint32_t VERSION = 1;
+	static constexpr uint64_t FILE_ALIGNMENT = 64;
+};
+
+// Storage selects how nodes are kept, see node_storage.h.
+// FlatNodeStorage (default) keeps them in one open addressing array, MapNodeStorage in a std::unordered_map.
+template <class T, class Code = uint32_t, class Storage = FlatNodeStorage<LOctantNode<T, Code>>>
+class LinearOctree
+{
+public:
+
+	using Point = glm::vec3;
+	using Element = T;
+	using Node = LOctantNode<T, Code>;
+	using CodeType = Code;
+
+	static_assert(std::is_same<Code, uint32_t>::value || std::is_same<Code, uint64_t>::value, "locational codes are uint32_t or uint64_t");
+	static constexpr size_t MAX_DEPTH = (sizeof(Code) * 8 - 1) / 3;
+	// data is empty for nodes without elements. spans into the payload stay valid until the tree is modified.
+	using Callback = std::function<bool(const Point& min, const Point& max, std::span<T> data)>;
+	// per leaf hit test, t holds the closest hit so far. lowers t and returns true when an element is hit before it.
+	using RayCallback = std::function<bool(std::span<T> elements, float& t)>;
+	// position of an element for the proximity queries, must be safe to call from several threads for the batched forms
+	using PositionFn = std::function<Point(const T&)>;
+
+	struct Neighbor
+	{
+		T* element;
+		float distance2;
+	};
+
+	struct Stats
+	{
+		size_t node_count = 0;
+		size_t leaf_count = 0;
+		size_t element_count = 0;
+		// occupancy[i] counts the leaves holding [2^i, 2^(i+1)) elements, empty leaves are not counted
+		std::vector<size_t> occupancy;
+		// nodes and leaves per depth, indexed by depth
+		std::vector<size_t> depth_nodes;
+		std::vector<size_t> depth_leaves;
+		size_t node_bytes = 0;    // node storage
+		size_t payload_bytes = 0; // leaf pool, free blocks included
+		size_t free_slots = 0;    // pool slots in free blocks
+		size_t proxy_count = 0;   // nodes with a level of detail proxy
+		size_t proxy_bytes = 0;
+		size_t bytes = 0;         // everything, tree object included
+	};
+
+	enum ErrorCode
+	{
+		SUCCESS,
+		PUSH_ERROR_DATAPOINT_OUT_OF_RANGE,
+		BUILD_ERROR_SIZE_MISMATCH,
+		UPDATE_ERROR_NOT_FOUND
+	};
+
+	// looseness > 1 turns on the loose octree mode: every node also covers (looseness - 1) / 2 of its size on each side,
+	// which lets push(box_min, box_max) store objects with extents in a single node, interior nodes included.
+	LinearOctree(const Point& min, float size_length, size_t max_depth, size_t max_element_per_leaf_node = 0, float looseness = 1.0f);
+	~LinearOctree();
+
+	LinearOctree(const LinearOctree&) = delete;
+	LinearOctree(LinearOctree&&) = delete;
+	void operator=(const LinearOctree&) = delete;
+	void operator=(LinearOctree&&) = delete;
+
+	// MEMBERS
+	bool traverse(Callback callback);
+	// same contract as traverse(Callback) for any callable visitor(min, max, std::span<T>) -> bool.
+	// the visitor is inlined and nodes are walked with an explicit stack in the same pre-order.
+	// the tree must not be modified from inside the visitor.
+	template <class Visitor>
+	bool traverse(Visitor&& visitor);
+	void clear();
+	// both return the stored copy of element, nullptr on error. the pointer survives edits of other nodes,
+	// it is invalidated by edits of its own node, build, map and clear.
+	T* push(const Point& data_point, const T& element, ErrorCode& error);
+	// loose mode only: stores the box in the deepest node that contains its center and whose loose bounds contain all of it
+	T* push(const Point& box_min, const Point& box_max, const T& element, ErrorCode& error);
+
+	// incremental edits. a Handle is the locational code of the node holding an element, computed
+	// arithmetically from the position so an update that stays in the same node touches no memory.
+	// remove and update find the element with operator== and swap it with the last one of its node.
+	// nodes left empty are collapsed into their parent. an update whose element is not in the node of its handle
+	// fails with UPDATE_ERROR_NOT_FOUND and leaves the tree unchanged.
+	using Handle = Code;
+	Handle insert(const Point& data_point, const T& element, ErrorCode& error);
+	Handle insert(const Point& box_min, const Point& box_max, const T& element, ErrorCode& error);
+	bool remove(Handle handle, const T& element);
+	Handle update(Handle handle, const T& element, const Point& new_point, ErrorCode& error);
+	Handle update(Handle handle, const T& element, const Point& new_min, const Point& new_max, ErrorCode& error);
+	// replaces the tree content, elements[i] is stored in the leaf containing points[i].
+	// the payloads are packed leaf after leaf in Morton order without slack.
+	// points outside the tree are skipped and reported with PUSH_ERROR_DATAPOINT_OUT_OF_RANGE.
+	ErrorCode build(std::span<const Point> points, std::span<const T> elements);
+	// concurrent insert mode. between begin_concurrent and end_concurrent any number of threads may call
+	// insert_concurrent and nothing else may touch the tree. every cell at split_depth is an independent subtree
+	// staging its elements behind its own lock, threads only wait on each other inside the same cell.
+	// end_concurrent sorts the subtrees in parallel and merges them, with build() speed into an empty tree.
+	void begin_concurrent(size_t split_depth = 2);
+	bool insert_concurrent(const Point& data_point, const T& element);
+	void end_concurrent();
+	// writes the tree in the OctreeFileHeader layout. payloads are written bytewise, T must be trivially copyable.
+	bool save(const std::string& file);
+	// maps a file written by save and answers queries straight from the mapping, nothing is rebuilt or copied.
+	// bounds, depth and looseness are taken from the file. needs MappedNodeStorage, see MappedLinearOctree.
+	bool map(const std::string& file);
+
+	// collects the payload of every leaf whose bounds touch the camera frustum.
+	// nodes completely inside the frustum are accepted with all their descendants without further plane tests.
+	bool cullFrustum(const camera::FreeCamera& camera, std::vector<std::span<T>>& visible_leaves);
+	// hierarchical level of detail. a proxy is a coarser stand-in for everything stored in a node and below it,
+	// error is its largest world space deviation from the elements it replaces. proxies are kept beside the nodes,
+	// save does not write them and edits leave them stale, set them again after the tree changes.
+	void set_proxy(const LOctantNode<T, Code>* node, std::span<const T> elements, float error);
+	void clear_proxies();
+	// frustum cull that stops descending at the first node whose proxy error, projected with camera.proj() at the
+	// closest point of the node, is at most max_pixel_error pixels of a viewport_height tall viewport.
+	// the proxy is collected instead of the node and its subtree.
+	bool cullFrustum(const camera::FreeCamera& camera, float viewport_height, float max_pixel_error, std::vector<std::span<T>>& visible);
+	// walks the octants hit by the ray front to back and stops once no remaining octant can hold a closer hit.
+	// returns true on hit, hit_t is the distance along dir (dir does not need to be normalized).
+	bool raycast(const Point& origin, const Point& dir, float max_t, RayCallback callback, float& hit_t);
+	// the k elements closest to p, nearest first. nodes are expanded best first and pruned by their box distance.
+	void knn(const Point& p, size_t k, const PositionFn& position_of, std::vector<Neighbor>& out);
+	// every element within r of p, in no particular order
+	void radius(const Point& p, float r, const PositionFn& position_of, std::vector<Neighbor>& out);
+	// one query per point, spread over worker threads. results[i] answers queries[i].
+	void knn(std::span<const Point> queries, size_t k, const PositionFn& position_of, std::vector<std::vector<Neighbor>>& results);
+	void radius(std::span<const Point> queries, float r, const PositionFn& position_of, std::vector<std::vector<Neighbor>>& results);
+
+	// ACCESSORS
+	size_t node_depth(const LOctantNode<T, Code>* node);
+	LOctantNode<T, Code>* parent_node(const LOctantNode<T, Code>* node);
+	// face neighbour of node: the node of the same depth across the face, or the coarser leaf
+	// covering that space. nullptr on the tree border or when no node exists
+	// on that side below the common ancestor. no traversal, the code is offset arithmetically.
+	LOctantNode<T, Code>* neighbor(const LOctantNode<T, Code>* node, LDirection direction);
+	bool is_leaf(const LOctantNode<T, Code>* node);
+	bool is_valid_node(LOctantNode<T, Code>* node);
+	std::span<T> node_data(const LOctantNode<T, Code>* node);
+	// empty when the node has no proxy
+	std::span<T> node_proxy(const LOctantNode<T, Code>* node, float& error);
+	// tight bounds of the node, decoded from its locational code
+	void node_bounds(const LOctantNode<T, Code>* node, Point& min, Point& max) const;
+	// cube covered by the root, as constructed or read from a mapped file
+	void bounds(Point& min, Point& max) const;
+	bool is_loose() const;
+	void loose_bounds(const Point& min, const Point& max, Point& loose_min, Point& loose_max) const;
+	void linearProcess(std::function<void(LOctantNode<T, Code>&)> callback, bool only_data_node);
+	// one pass over the node storage, cheap enough to log after every rebuild
+	Stats stats();
+
+private:
+	Point d_min;
+	Point d_max;
+	size_t d_max_depth;
+	size_t d_max_element_per_node;
+	float d_looseness;
+	Storage d_nodes;
+	LeafPool<T> d_pool;
+	std::unique_ptr<util::MappedFile> d_file; // set while the tree is mapped
+
+	struct alignas(64) Subtree
+	{
+		std::mutex lock;
+		std::vector<MortonKey<Code>> keys; // index points into items
+		std::vector<T> items;
+	};
+	std::unique_ptr<Subtree[]> d_subtrees; // set in concurrent insert mode
+	size_t d_split_depth = 0;
+
+	struct Proxy
+	{
+		float error = 0.0f;
+		std::vector<T> elements;
+	};
+	std::unordered_map<Code, Proxy> d_proxies; // by locational code
+	const Code ROOT_CODE = 1; // 001, 1 000, 1 001 ...
+
+	// HELPERS
+	LOctantNode<T, Code>* LookupNode(Code locCode);
+	size_t code_depth(Code locCode) const;
+	Code code_of(const Point& p, size_t depth) const;
+	size_t fit_depth(const Point& box_min, const Point& box_max) const;
+	LOctantNode<T, Code>* create_path(Code locCode);
+	T& append(LOctantNode<T, Code>* node, const T& element);
+	void collapse(Code locCode);
+	// fills an empty tree from leaf codes sorted ascending, items[i] belongs to keys[i]
+	void assemble(std::span<const MortonKey<Code>> keys, std::vector<T>&& items);
+	void cullRecursive(const camera::Frustum& frustum, const Point& curr_min, const Point& curr_max, LOctantNode<T, Code>* curr_node, std::vector<std::span<T>>& out);
+	void collectRecursive(LOctantNode<T, Code>* curr_node, std::vector<std::span<T>>& out);
+	// pixel_scale turns error / distance into pixels, inside skips the plane tests below a node inside the frustum
+	void lodRecursive(const camera::Frustum& frustum, const Point& eye, float pixel_scale, float max_pixel_error, bool inside,
+		const Point& curr_min, const Point& curr_max, LOctantNode<T, Code>* curr_node, std::vector<std::span<T>>& out);
+	bool raycastRecursive(const Point& origin, const Point& inv_dir, uint32_t dir_mask, const Point& curr_min, const Point& curr_max,
+		LOctantNode<T, Code>* curr_node, RayCallback& callback, float& best_t);
+	bool intersect_ray(const Point& origin, const Point& inv_dir, const Point& min, const Point& max, float max_t, float& t_enter);
+	void radiusRecursive(const Point& p, float r2, const Point& curr_min, const Point& curr_max, LOctantNode<T, Code>* curr_node,
+		const PositionFn& position_of, std::vector<Neighbor>& out);
+	float distance2_to_box(const Point& p, const Point& min, const Point& max);
+	LOctantNode<T, Code>* root_node();
+	LOctantNode<T, Code>* get_node_from(LOctantNode<T, Code>* parent, LOctant octant);
+	bool is_inside(const Point& sample, const Point& min, const Point& max);
+
+	LOctantNode<T, Code>* split(const Point& data_point, LOctantNode<T, Code>* currnode, const Point& min, const Point& max, int& depth);
+
+	// bit operations
+	void set_8bit_mut(uint8_t& input, size_t index, bool val);
+	void set_code_bit_mut(Code& input, size_t index, bool val);
+	uint8_t set_8bit(const uint8_t& input, size_t index, bool val);
+	Code set_code_bit(const Code& input, size_t index, bool val);
+	Code shift_left(const Code& input, size_t count);
+	Code shift_right(const Code& input, size_t count);
+	bool is_bit_set_8bit(const uint8_t& flag, size_t index);
+};
+
+
+template<class T, class Code, class Storage>
+inline LinearOctree<T, Code, Storage>::LinearOctree(const Point& min, float side_length, size_t max_depth, size_t max_element_per_leaf_node, float looseness)
+	: d_min(min)
+	, d_max(min.x + side_length, min.y + side_length, min.z + side_length)
+	, d_max_depth(max_depth)
+	, d_max_element_per_node(max_element_per_leaf_node)
+	, d_looseness(looseness)
+{
+	assert(d_max_depth <= MAX_DEPTH);
+	assert(d_looseness >= 1.0f);
+}
+
+template<class T, class Code, class Storage>
+inline LinearOctree<T, Code, Storage>::~LinearOctree()
+{
+	clear();
+}
+
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::traverse(Callback callback)
+{
+	assert(callback);
+
+	if (d_nodes.empty())
+	{
+		return false;
+	}
+
+	return traverse<Callback&>(callback);
+}
+
+template<class T, class Code, class Storage>
+template<class Visitor>
+inline bool LinearOctree<T, Code, Storage>::traverse(Visitor&& visitor)
+{
+	if (d_nodes.empty())
+	{
+		return false;
+	}
+
+	struct Entry
+	{
+		LOctantNode<T, Code>* node;
+		Point min;
+		size_t depth;
+	};
+
+	// node sizes per depth, child corners are then min + size on the axes set in the octant
+	float sizes[MAX_DEPTH + 1];
+	sizes[0] = d_max.x - d_min.x;
+	for (size_t i = 1; i <= d_max_depth; ++i)
+	{
+		sizes[i] = sizes[i - 1] * 0.5f;
+	}
+
+	// a popped node pushes at most 8 children, so the stack never holds more than 7 per level plus one
+	Entry stack[7 * MAX_DEPTH + 1];
+	size_t top = 0;
+
+	auto* root = LookupNode(ROOT_CODE);
+	if (root)
+	{
+		stack[top++] = { root, d_min, 0 };
+	}
+
+	while (top > 0)
+	{
+		const Entry entry = stack[--top];
+		auto* node = entry.node;
+		const float size = sizes[entry.depth];
+
+		if (!visitor(entry.min, entry.min + Point(size), node_data(node)))
+		{
+			continue;
+		}
+
+		if (node->childrenFlags == 0)
+		{
+			continue;
+		}
+
+		const float half = sizes[entry.depth + 1];
+		const Code childBase = node->locCode << 3;
+
+		// reverse order so octant 0 is popped first, like the recursive pre-order
+		for (int i = LOctant::OCTANT_SIZE - 1; i >= 0; --i)
+		{
+			if (!(node->childrenFlags & (1 << i)))
+			{
+				continue;
+			}
+
+			auto* child = LookupNode(childBase | (Code)i);
+			if (!child)
+			{
+				continue;
+			}
+
+			const Point child_min(
+				entry.min.x + ((i & 1) ? half : 0.0f),
+				entry.min.y + ((i & 4) ? half : 0.0f),
+				entry.min.z + ((i & 2) ? half : 0.0f));
+
+			stack[top++] = { child, child_min, entry.depth + 1 };
+		}
+	}
+
+	return true;
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::clear()
+{
+	// nodes and pool are flat arrays of plain records, both are released without walking the tree
+	d_nodes.clear();
+	d_pool.clear();
+	d_proxies.clear();
+	d_file = nullptr;
+}
+
+template<class T, class Code, class Storage>
+inline T* LinearOctree<T, Code, Storage>::push(const Point& data_point, const T& element, ErrorCode& error)
+{
+	if (!is_inside(data_point, d_min, d_max))
+	{
+		error = PUSH_ERROR_DATAPOINT_OUT_OF_RANGE;
+		return nullptr;
+	}
+
+	error = SUCCESS;
+	int depth = 0;
+	return &append(split(data_point, root_node(), d_min, d_max, depth), element);
+}
+
+template<class T, class Code, class Storage>
+inline T* LinearOctree<T, Code, Storage>::push(const Point& box_min, const Point& box_max, const T& element, ErrorCode& error)
+{
+	assert(is_loose());
+
+	const Point center = (box_min + box_max) * 0.5f;
+	const Point extent = box_max - box_min;
+	const float max_extent = std::max(std::max(extent.x, extent.y), extent.z);
+
+	if (!is_inside(center, d_min, d_max) || max_extent > (d_looseness - 1.0f) * (d_max.x - d_min.x))
+	{
+		error = PUSH_ERROR_DATAPOINT_OUT_OF_RANGE;
+		return nullptr;
+	}
+
+	auto* node = create_path(code_of(center, fit_depth(box_min, box_max)));
+
+	error = SUCCESS;
+	return &append(node, element);
+}
+
+template<class T, class Code, class Storage>
+inline typename LinearOctree<T, Code, Storage>::Handle LinearOctree<T, Code, Storage>::insert(const Point& data_point, const T& element, ErrorCode& error)
+{
+	if (!is_inside(data_point, d_min, d_max))
+	{
+		error = PUSH_ERROR_DATAPOINT_OUT_OF_RANGE;
+		return 0;
+	}
+
+	auto* node = create_path(code_of(data_point, d_max_depth));
+	append(node, element);
+
+	error = SUCCESS;
+	return node->locCode;
+}
+
+template<class T, class Code, class Storage>
+inline typename LinearOctree<T, Code, Storage>::Handle LinearOctree<T, Code, Storage>::insert(const Point& box_min, const Point& box_max, const T& element, ErrorCode& error)
+{
+	if (!push(box_min, box_max, element, error))
+	{
+		return 0;
+	}
+
+	return code_of((box_min + box_max) * 0.5f, fit_depth(box_min, box_max));
+}
+
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::remove(Handle handle, const T& element)
+{
+	auto* node = handle ? LookupNode(handle) : nullptr;
+	if (!node || node->count == 0)
+	{
+		return false;
+	}
+
+	auto data = node_data(node);
+	auto it = std::find(data.begin(), data.end(), element);
+	if (it == data.end())
+	{
+		return false;
+	}
+
+	if (it != data.end() - 1)
+	{
+		*it = std::move(data.back());
+	}
+	data.back() = T(); // the slot stays in the block, drop what it references
+	--node->count;
+
+	if (node->count == 0)
+	{
+		d_pool.release(node->first, node->capacity);
+		node->first = 0;
+		node->capacity = 0;
+		collapse(handle);
+	}
+	return true;
+}
+
+template<class T, class Code, class Storage>
+inline typename LinearOctree<T, Code, Storage>::Handle LinearOctree<T, Code, Storage>::update(Handle handle, const T& element, const Point& new_point, ErrorCode& error)
+{
+	if (!is_inside(new_point, d_min, d_max))
+	{
+		error = PUSH_ERROR_DATAPOINT_OUT_OF_RANGE;
+		return handle;
+	}
+
+	error = SUCCESS;
+	if (code_of(new_point, d_max_depth) == handle)
+	{
+		return handle; // still in the same leaf
+	}
+
+	if (!remove(handle, element))
+	{
+		error = UPDATE_ERROR_NOT_FOUND;
+		return handle;
+	}
+	return insert(new_point, element, error);
+}
+
+template<class T, class Code, class Storage>
+inline typename LinearOctree<T, Code, Storage>::Handle LinearOctree<T, Code, Storage>::update(Handle handle, const T& element, const Point& new_min, const Point& new_max, ErrorCode& error)
+{
+	const Point center = (new_min + new_max) * 0.5f;
+	if (!is_inside(center, d_min, d_max))
+	{
+		error = PUSH_ERROR_DATAPOINT_OUT_OF_RANGE;
+		return handle;
+	}
+
+	error = SUCCESS;
+	if (code_of(center, fit_depth(new_min, new_max)) == handle)
+	{
+		return handle; // still fits the same node
+	}
+
+	if (!remove(handle, element))
+	{
+		error = UPDATE_ERROR_NOT_FOUND;
+		return handle;
+	}
+	return insert(new_min, new_max, element, error);
+}
+
+template<class T, class Code, class Storage>
+inline typename LinearOctree<T, Code, Storage>::ErrorCode LinearOctree<T, Code, Storage>::build(std::span<const Point> points, std::span<const T> elements)
+{
+	clear();
+
+	if (points.size() != elements.size())
+	{
+		return BUILD_ERROR_SIZE_MISMATCH;
+	}
+
+	if (points.empty())
+	{
+		return SUCCESS;
+	}
+
+	// 1. quantize every point to a max depth cell and compute its leaf code, 0 marks a rejected point
+	const uint32_t cells = 1u << d_max_depth;
+	const Code flag = Code(1) << (3 * d_max_depth);
+	const Point scale = Point((float)cells) / (d_max - d_min);
+
+	std::vector<MortonKey<Code>> keys(points.size());
+	util::Parallel::forEach(points.size(), [&](size_t i) {
+		keys[i].index = (uint32_t)i;
+		keys[i].code = 0;
+
+		if (is_inside(points[i], d_min, d_max))
+		{
+			const Point cell = (points[i] - d_min) * scale;
+			const uint32_t x = std::min((uint32_t)cell.x, cells - 1);
+			const uint32_t y = std::min((uint32_t)cell.y, cells - 1);
+			const uint32_t z = std::min((uint32_t)cell.z, cells - 1);
+			keys[i].code = flag | morton_encode<Code>(x, y, z);
+		}
+	});
+
+	// 2. sort by code, rejected points end up in front
+	radix_sort(keys, 3 * (unsigned)d_max_depth + 1);
+
+	size_t first = 0;
+	while (first < keys.size() && keys[first].code == 0)
+	{
+		++first;
+	}
+
+	// 3. the payload array follows the sorted keys, so every leaf owns one packed range of it
+	std::vector<T> items(keys.size() - first);
+	util::Parallel::forEach(items.size(), [&](size_t i) {
+		items[i] = elements[keys[first + i].index];
+	});
+
+	assemble(std::span<const MortonKey<Code>>(keys).subspan(first), std::move(items));
+
+	return first == 0 ? SUCCESS : PUSH_ERROR_DATAPOINT_OUT_OF_RANGE;
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::assemble(std::span<const MortonKey<Code>> keys, std::vector<T>&& items)
+{
+	assert(keys.size() == items.size() && d_nodes.empty());
+
+	if (keys.empty())
+	{
+		return;
+	}
+
+	// one leaf per run of equal codes
+	std::vector<size_t> runs;
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		if (i == 0 || keys[i].code != keys[i - 1].code)
+		{
+			runs.push_back(i);
+		}
+	}
+	runs.push_back(keys.size());
+
+	std::vector<LOctantNode<T, Code>> level(runs.size() - 1);
+	util::Parallel::forEach(level.size(), [&](size_t r) {
+		auto& leaf = level[r];
+		leaf.locCode = keys[runs[r]].code;
+		leaf.childrenFlags = 0;
+		leaf.first = (uint32_t)runs[r];
+		leaf.count = (uint32_t)(runs[r + 1] - runs[r]);
+		leaf.capacity = leaf.count;
+	});
+	d_pool.assign(std::move(items));
+
+	// emit interior levels bottom up, sorted children give sorted parents
+	std::vector<std::vector<LOctantNode<T, Code>>> levels;
+	size_t total = level.size();
+	levels.push_back(std::move(level));
+
+	for (size_t depth = d_max_depth; depth > 0; --depth)
+	{
+		std::vector<LOctantNode<T, Code>> parents;
+		for (const auto& child : levels.back())
+		{
+			const Code parentCode = child.locCode >> 3;
+			if (parents.empty() || parents.back().locCode != parentCode)
+			{
+				parents.emplace_back();
+				parents.back().locCode = parentCode;
+			}
+			parents.back().childrenFlags |= (uint8_t)(1u << (child.locCode & 7));
+		}
+
+		total += parents.size();
+		levels.push_back(std::move(parents));
+	}
+
+	d_nodes.reserve(total);
+	for (auto it = levels.rbegin(); it != levels.rend(); ++it)
+	{
+		for (auto& node : *it)
+		{
+			d_nodes.insert(node.locCode) = std::move(node);
+		}
+	}
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::begin_concurrent(size_t split_depth)
+{
+	assert(!d_subtrees);
+	d_split_depth = std::min(split_depth, d_max_depth);
+	d_subtrees = std::make_unique<Subtree[]>(size_t(1) << (3 * d_split_depth));
+}
+
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::insert_concurrent(const Point& data_point, const T& element)
+{
+	assert(d_subtrees);
+
+	if (!is_inside(data_point, d_min, d_max))
+	{
+		return false;
+	}
+
+	// the top split_depth levels of the leaf code select the subtree
+	const Code code = code_of(data_point, d_max_depth);
+	const Code cell_mask = shift_left(Code(1), 3 * d_split_depth) - 1;
+	auto& subtree = d_subtrees[(size_t)(shift_right(code, 3 * (d_max_depth - d_split_depth)) & cell_mask)];
+
+	std::lock_guard<std::mutex> guard(subtree.lock);
+	subtree.keys.push_back({ code, (uint32_t)subtree.items.size() });
+	subtree.items.push_back(element);
+	return true;
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::end_concurrent()
+{
+	assert(d_subtrees);
+	const size_t count = size_t(1) << (3 * d_split_depth);
+
+	std::vector<size_t> offsets(count + 1, 0);
+	for (size_t s = 0; s < count; ++s)
+	{
+		offsets[s + 1] = offsets[s] + d_subtrees[s].keys.size();
+	}
+
+	// keys of a subtree share their top bits, only the levels below the split need sorting.
+	// subtrees in cell order are then sorted against each other as well.
+	util::Parallel::forEach(count, [&](size_t s) {
+		radix_sort(d_subtrees[s].keys, 3 * (unsigned)(d_max_depth - d_split_depth));
+	}, 1);
+
+	if (d_nodes.empty())
+	{
+		std::vector<MortonKey<Code>> keys(offsets[count]);
+		std::vector<T> items(offsets[count]);
+
+		util::Parallel::forEach(count, [&](size_t s) {
+			auto& subtree = d_subtrees[s];
+			for (size_t i = 0; i < subtree.keys.size(); ++i)
+			{
+				keys[offsets[s] + i] = { subtree.keys[i].code, (uint32_t)(offsets[s] + i) };
+				items[offsets[s] + i] = std::move(subtree.items[subtree.keys[i].index]);
+			}
+		}, 1);
+
+		assemble(keys, std::move(items));
+	}
+	else
+	{
+		// merging into existing content walks one path per staged leaf
+		for (size_t s = 0; s < count; ++s)
+		{
+			auto& subtree = d_subtrees[s];
+			LOctantNode<T, Code>* node = nullptr;
+
+			for (size_t i = 0; i < subtree.keys.size(); ++i)
+			{
+				if (i == 0 || subtree.keys[i].code != subtree.keys[i - 1].code)
+				{
+					node = create_path(subtree.keys[i].code);
+				}
+				append(node, subtree.items[subtree.keys[i].index]);
+			}
+		}
+	}
+
+	d_subtrees = nullptr;
+}
+
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::save(const std::string& file)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "saved payloads are copied bytewise");
+	static_assert(std::has_unique_object_representations_v<LOctantNode<T, Code>>, "saved nodes must not contain padding");
+
+	std::vector<LOctantNode<T, Code>> nodes;
+	nodes.reserve(d_nodes.size());
+	d_nodes.for_each([&](LOctantNode<T, Code>& node) {
+		nodes.push_back(node);
+	});
+
+	std::sort(nodes.begin(), nodes.end(), [](const LOctantNode<T, Code>& a, const LOctantNode<T, Code>& b) {
+		return a.locCode < b.locCode;
+	});
+
+	// repack the payload ranges without the slack of incremental inserts
+	uint64_t element_count = 0;
+	for (auto& node : nodes)
+	{
+		node.first = (uint32_t)element_count;
+		node.capacity = node.count;
+		element_count += node.count;
+	}
+
+	auto align = [](uint64_t offset) {
+		return (offset + OctreeFileHeader::FILE_ALIGNMENT - 1) & ~(OctreeFileHeader::FILE_ALIGNMENT - 1);
+	};
+
+	OctreeFileHeader header = {};
+	std::memcpy(header.magic, OctreeFileHeader::MAGIC, sizeof(header.magic));
+	header.version = OctreeFileHeader::VERSION;
+	header.code_size = sizeof(Code);
+	header.node_size = sizeof(LOctantNode<T, Code>);
+	header.element_size = sizeof(T);
+	header.max_depth = (uint32_t)d_max_depth;
+	header.max_element_per_node = (uint32_t)d_max_element_per_node;
+	header.min[0] = d_min.x;
+	header.min[1] = d_min.y;
+	header.min[2] = d_min.z;
+	header.side_length = d_max.x - d_min.x;
+	header.looseness = d_looseness;
+	header.node_count = nodes.size();
+	header.node_offset = align(sizeof(OctreeFileHeader));
+	header.element_count = element_count;
+	header.element_offset = align(header.node_offset + nodes.size() * sizeof(LOctantNode<T, Code>));
+
+	std::ofstream out(file, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		return false;
+	}
+
+	const char zeros[OctreeFileHeader::FILE_ALIGNMENT] = {};
+	auto pad_to = [&](uint64_t offset) {
+		out.write(zeros, (std::streamsize)(offset - (uint64_t)out.tellp()));
+	};
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	pad_to(header.node_offset);
+	out.write(reinterpret_cast<const char*>(nodes.data()), (std::streamsize)(nodes.size() * sizeof(LOctantNode<T, Code>)));
+	pad_to(header.element_offset);
+
+	for (const auto& node : nodes)
+	{
+		if (node.count == 0)
+		{
+			continue;
+		}
+
+		const auto data = node_data(LookupNode(node.locCode));
+		out.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size_bytes());
+	}
+
+	return out.good();
+}
+
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::map(const std::string& file)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "mapped payloads are used bytewise");
+	clear();
+
+	auto mapped = std::make_unique<util::MappedFile>();
+	if (!mapped->open(file) || mapped->size() < sizeof(OctreeFileHeader))
+	{
+		return false;
+	}
+
+	OctreeFileHeader header;
+	std::memcpy(&header, mapped->data(), sizeof(header));
+
+	const uint64_t node_bytes = header.node_count * sizeof(LOctantNode<T, Code>);
+	const uint64_t element_bytes = header.element_count * sizeof(T);
+
+	if (std::memcmp(header.magic, OctreeFileHeader::MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != OctreeFileHeader::VERSION ||
+		header.code_size != sizeof(Code) ||
+		header.node_size != sizeof(LOctantNode<T, Code>) ||
+		header.element_size != sizeof(T) ||
+		header.max_depth > MAX_DEPTH ||
+		header.node_offset % alignof(LOctantNode<T, Code>) != 0 ||
+		header.element_offset % alignof(T) != 0 ||
+		header.node_offset + node_bytes > mapped->size() ||
+		header.element_offset + element_bytes > mapped->size())
+	{
+		return false;
+	}
+
+	d_min = Point(header.min[0], header.min[1], header.min[2]);
+	d_max = d_min + Point(header.side_length);
+	d_max_depth = header.max_depth;
+	d_max_element_per_node = header.max_element_per_node;
+	d_looseness = header.looseness;
+
+	d_nodes.attach(reinterpret_cast<LOctantNode<T, Code>*>(mapped->data() + header.node_offset), (size_t)header.node_count);
+	d_pool.attach(reinterpret_cast<T*>(mapped->data() + header.element_offset), (size_t)header.element_count);
+	d_file = std::move(mapped);
+	return true;
+}
+
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::cullFrustum(const camera::FreeCamera& camera, std::vector<std::span<T>>& visible_leaves)
+{
+	visible_leaves.clear();
+
+	if (d_nodes.empty())
+	{
+		return false;
+	}
+
+	const camera::Frustum frustum(camera.planes());
+	cullRecursive(frustum, d_min, d_max, LookupNode(ROOT_CODE), visible_leaves);
+	return true;
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::set_proxy(const LOctantNode<T, Code>* node, std::span<const T> elements, float error)
+{
+	assert(node);
+	auto& proxy = d_proxies[node->locCode];
+	proxy.error = error;
+	proxy.elements.assign(elements.begin(), elements.end());
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::clear_proxies()
+{
+	d_proxies.clear();
+}
+
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::cullFrustum(const camera::FreeCamera& camera, float viewport_height, float max_pixel_error, std::vector<std::span<T>>& visible)
+{
+	visible.clear();
+
+	if (d_nodes.empty())
+	{
+		return false;
+	}
+
+	// proj[1][1] is cot(fov / 2): a world length e at distance d covers e / d * proj[1][1] * height / 2 pixels
+	const float pixel_scale = std::abs(camera.proj()[1][1]) * viewport_height * 0.5f;
+
+	const camera::Frustum frustum(camera.planes());
+	lodRecursive(frustum, camera.position(), pixel_scale, max_pixel_error, false, d_min, d_max, LookupNode(ROOT_CODE), visible);
+	return true;
+}
+
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::raycast(const Point& origin, const Point& dir, float max_t, RayCallback callback, float& hit_t)
+{
+	assert(callback);
+
+	if (d_nodes.empty())
+	{
+		return false;
+	}
+
+	// zero components become huge slopes instead of inf * 0 = nan in the slab test
+	Point inv_dir;
+	for (int i = 0; i < 3; ++i)
+	{
+		const float d = std::abs(dir[i]) < 1e-20f ? std::copysign(1e-20f, dir[i]) : dir[i];
+		inv_dir[i] = 1.0f / d;
+	}
+
+	// children are visited in order octant ^ dir_mask, along the ray the flipped octant bits only go from 0 to 1
+	const uint32_t dir_mask = (dir.x < 0.0f ? 1u : 0u) | (dir.z < 0.0f ? 2u : 0u) | (dir.y < 0.0f ? 4u : 0u);
+
+	float best_t = max_t;
+	float t_enter;
+	if (!intersect_ray(origin, inv_dir, d_min, d_max, best_t, t_enter))
+	{
+		return false;
+	}
+
+	if (!raycastRecursive(origin, inv_dir, dir_mask, d_min, d_max, LookupNode(ROOT_CODE), callback, best_t))
+	{
+		return false;
+	}
+
+	hit_t = best_t;
+	return true;
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::knn(const Point& p, size_t k, const PositionFn& position_of, std::vector<Neighbor>& out)
+{
+	assert(position_of);
+	out.clear();
+
+	if (d_nodes.empty() || k == 0)
+	{
+		return;
+	}
+
+	struct Entry
+	{
+		float distance2;
+		LOctantNode<T, Code>* node;
+		Point min;
+		Point max;
+		bool operator<(const Entry& other) const { return distance2 > other.distance2; } // min heap
+	};
+
+	auto farther = [](const Neighbor& a, const Neighbor& b) { return a.distance2 < b.distance2; };
+
+	// nodes ordered by box distance, results kept as a max heap bounded to k
+	std::priority_queue<Entry> nodes;
+	nodes.push({ distance2_to_box(p, d_min, d_max), LookupNode(ROOT_CODE), d_min, d_max });
+	out.reserve(k);
+
+	while (!nodes.empty())
+	{
+		const Entry entry = nodes.top();
+		nodes.pop();
+
+		if (out.size() == k && entry.distance2 >= out.front().distance2)
+		{
+			break; // no remaining node can hold a closer element
+		}
+
+		auto* node = entry.node;
+
+		for (auto& elem : node_data(node))
+		{
+			const Point delta = position_of(elem) - p;
+			const float d2 = glm::dot(delta, delta);
+
+			if (out.size() < k)
+			{
+				out.push_back({ &elem, d2 });
+				std::push_heap(out.begin(), out.end(), farther);
+			}
+			else if (d2 < out.front().distance2)
+			{
+				std::pop_heap(out.begin(), out.end(), farther);
+				out.back() = { &elem, d2 };
+				std::push_heap(out.begin(), out.end(), farther);
+			}
+		}
+
+		const Point half_delta = (entry.max - entry.min) * 0.5f;
+
+		for (int i = 0; i < LOctant::OCTANT_SIZE; ++i)
+		{
+			if (node->childrenFlags & (1 << i))
+			{
+				int x = i % 2, z = (i / 2) % 2, y = i / (2 * 2);
+
+				auto next_min = entry.min + half_delta * Point(x, y, z);
+				auto next_max = next_min + half_delta;
+				const float d2 = distance2_to_box(p, next_min, next_max);
+
+				if (out.size() < k || d2 < out.front().distance2)
+				{
+					nodes.push({ d2, LookupNode((node->locCode << 3) | i), next_min, next_max });
+				}
+			}
+		}
+	}
+
+	std::sort_heap(out.begin(), out.end(), farther);
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::radius(const Point& p, float r, const PositionFn& position_of, std::vector<Neighbor>& out)
+{
+	assert(position_of);
+	out.clear();
+
+	if (d_nodes.empty() || distance2_to_box(p, d_min, d_max) > r * r)
+	{
+		return;
+	}
+
+	radiusRecursive(p, r * r, d_min, d_max, LookupNode(ROOT_CODE), position_of, out);
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::knn(std::span<const Point> queries, size_t k, const PositionFn& position_of, std::vector<std::vector<Neighbor>>& results)
+{
+	results.resize(queries.size());
+	util::Parallel::forEach(queries.size(), [&](size_t i) {
+		knn(queries[i], k, position_of, results[i]);
+	}, 64);
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::radius(std::span<const Point> queries, float r, const PositionFn& position_of, std::vector<std::vector<Neighbor>>& results)
+{
+	results.resize(queries.size());
+	util::Parallel::forEach(queries.size(), [&](size_t i) {
+		radius(queries[i], r, position_of, results[i]);
+	}, 64);
+}
+
+template<class T, class Code, class Storage>
+inline size_t LinearOctree<T, Code, Storage>::node_depth(const LOctantNode<T, Code>* node)
+{
+	assert(node && node->locCode); // at least flag bit must be set
+	return code_depth(node->locCode);
+}
+
+template<class T, class Code, class Storage>
+inline LOctantNode<T, Code>* LinearOctree<T, Code, Storage>::parent_node(const LOctantNode<T, Code>* node)
+{
+	assert(node);
+	const Code locCodeParent = (node->locCode >> 3);
+	return LookupNode(locCodeParent);
+}
+
+template<class T, class Code, class Storage>
+inline LOctantNode<T, Code>* LinearOctree<T, Code, Storage>::neighbor(const LOctantNode<T, Code>* node, LDirection direction)
+{
+	assert(node && direction < DIRECTION_SIZE);
+
+	// bits of one axis inside the interleaved cell code, octant bit 0 = x, 1 = z, 2 = y
+	static const size_t AXIS_SHIFT[3] = { 0, 2, 1 };
+	const size_t depth = node_depth(node);
+	const Code cell_bits = shift_left(Code(1), 3 * depth) - 1;
+	const Code axis = (Code)(0x9249249249249249ull << AXIS_SHIFT[direction / 2]) & cell_bits;
+	const Code coord = node->locCode & axis;
+
+	// add or subtract one on the dilated coordinate, the other bits are masked so the carry runs through them
+	Code moved;
+	if (direction % 2)
+	{
+		if (coord == axis)
+		{
+			return nullptr; // max face of the tree
+		}
+		moved = ((coord | ~axis) + 1) & axis;
+	}
+	else
+	{
+		if (coord == 0)
+		{
+			return nullptr; // min face of the tree
+		}
+		moved = (coord - 1) & axis;
+	}
+
+	Code code = (node->locCode & ~axis) | moved;
+	for (size_t level = depth;; --level)
+	{
+		auto* found = LookupNode(code);
+		if (found)
+		{
+			// a coarser node only covers that space when it is a leaf, an interior one (including a common
+			// ancestor of node) means the other side holds no node down to this depth
+			return (level < depth && !is_leaf(found)) ? nullptr : found;
+		}
+
+		if (level == 0)
+		{
+			return nullptr;
+		}
+		code >>= 3;
+	}
+}
+
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::is_leaf(const LOctantNode<T, Code>* node)
+{
+	assert(node);
+	return node->childrenFlags == 0 ? true : false;
+}
 
-namespace octree
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::is_valid_node(LOctantNode<T, Code>* node)
 {
+	assert(node);
+	// interior nodes only hold data in loose mode
+	return (node->childrenFlags == 0 && node->count != 0 || node->childrenFlags != 0 && (node->count == 0 || is_loose())) ? true : false;
+}
 
-enum LOctant
+template<class T, class Code, class Storage>
+inline std::span<T> LinearOctree<T, Code, Storage>::node_data(const LOctantNode<T, Code>* node)
 {
-	DN_LEVEL_BACK_LEFT = 0,
-	DN_LEVEL_BACK_RIGHT,
-	DN_LEVEL_FRONT_LEFT,
-	DN_LEVEL_FRONT_RIGHT,
-	UP_LEVEL_BACK_LEFT,
-	UP_LEVEL_BACK_RIGHT,
-	UP_LEVEL_FRONT_LEFT,
-	UP_LEVEL_FRONT_RIGHT,
-	OCTANT_SIZE
-};
+	assert(node);
+	return d_pool.view(node->first, node->count);
+}
 
-template <class T>
-struct LOctantNode
+template<class T, class Code, class Storage>
+inline std::span<T> LinearOctree<T, Code, Storage>::node_proxy(const LOctantNode<T, Code>* node, float& error)
 {
-	uint32_t locCode;
-	uint8_t  childrenFlags;
-	std::unique_ptr<std::vector<T>> data;
-};
+	assert(node);
+	auto found = d_proxies.find(node->locCode);
+	if (found == d_proxies.end())
+	{
+		return std::span<T>();
+	}
+
+	error = found->second.error;
+	return std::span<T>(found->second.elements);
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::node_bounds(const LOctantNode<T, Code>* node, Point& min, Point& max) const
+{
+	assert(node && node->locCode);
 
+	// follow the octants from the root down, the top 3 bits below the flag belong to depth 1
+	min = d_min;
+	Point size = d_max - d_min;
+	for (size_t level = code_depth(node->locCode); level > 0; --level)
+	{
+		const int i = (int)((node->locCode >> (3 * (level - 1))) & 7);
+		int x = i % 2, z = (i / 2) % 2, y = i / (2 * 2);
 
+		size *= 0.5f;
+		min += size * Point(x, y, z);
+	}
+	max = min + size;
+}
 
-template <class T>
-class LinearOctree
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::bounds(Point& min, Point& max) const
 {
-public:
+	min = d_min;
+	max = d_max;
+}
 
-	using Point = glm::vec3;
-	using Callback = std::function<bool(const Point& min, const Point& max, std::vector<T>*)>;
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::is_loose() const
+{
+	return d_looseness > 1.0f;
+}
 
-	enum ErrorCode
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::loose_bounds(const Point& min, const Point& max, Point& loose_min, Point& loose_max) const
+{
+	const Point margin = (max - min) * ((d_looseness - 1.0f) * 0.5f);
+	loose_min = min - margin;
+	loose_max = max + margin;
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::linearProcess(std::function<void(LOctantNode<T, Code>&)> callback, bool only_data_node)
+{
+	// nodes are visited in storage order
+	if (only_data_node)
 	{
-		SUCCESS,
-		PUSH_ERROR_DATAPOINT_OUT_OF_RANGE
-	};
+		d_nodes.for_each([&](LOctantNode<T, Code>& node) {
+			if (node.count != 0)
+			{
+				callback(node);
+			}
+		});
+	}
+	else
+	{
+		d_nodes.for_each([&](LOctantNode<T, Code>& node) {
+			callback(node);
+		});
+	}
+}
 
-	LinearOctree(const Point& min, float size_length, size_t max_depth, size_t max_element_per_leaf_node = 0);
-	~LinearOctree();
+template<class T, class Code, class Storage>
+inline typename LinearOctree<T, Code, Storage>::Stats LinearOctree<T, Code, Storage>::stats()
+{
+	Stats result;
+	result.depth_nodes.resize(d_max_depth + 1, 0);
+	result.depth_leaves.resize(d_max_depth + 1, 0);
 
-	LinearOctree(const LinearOctree&) = delete;
-	LinearOctree(LinearOctree&&) = delete;
-	void operator=(const LinearOctree&) = delete;
-	void operator=(LinearOctree&&) = delete;
+	d_nodes.for_each([&](LOctantNode<T, Code>& node) {
+		const size_t depth = code_depth(node.locCode);
+		++result.node_count;
+		++result.depth_nodes[depth];
+		result.element_count += node.count;
 
-	// MEMBERS
-	bool traverse(Callback callback);
-	void clear();
-	std::vector<T>& push(const Point& data_point, ErrorCode& error, Callback callback = nullptr);
+		if (node.childrenFlags != 0)
+		{
+			return;
+		}
 
-	// ACCESSORS
-	size_t node_depth(const LOctantNode<T>* node);
-	LOctantNode<T>* parent_node(const LOctantNode<T>* node);
-	bool is_leaf(const LOctantNode<T>* node);
-	bool is_valid_node(LOctantNode<T>* node);
-	void linearProcess(std::function<void(LOctantNode<T>&)> callback, bool only_data_node);
+		++result.leaf_count;
+		++result.depth_leaves[depth];
 
-private:
-	Point d_min;
-	Point d_max;
-	size_t d_max_depth;
-	size_t d_max_element_per_node;
-	std::unordered_map<uint32_t, LOctantNode<T>> d_nodes;
-	const uint32_t ROOT_CODE = 1; // 001, 1 000, 1 001 ...
+		if (node.count == 0)
+		{
+			return;
+		}
 
-	// HELPERS
-	LOctantNode<T>* LookupNode(uint32_t locCode);
-	void traverseRecursive(Callback callback, const Point& curr_min, const Point& curr_max, const LOctantNode<T>* curr_node);
-	LOctantNode<T>* root_node();
-	LOctantNode<T>* get_node_from(LOctantNode<T>* parent, LOctant octant, bool isLeaf);
-	bool is_inside(const Point& sample, const Point& min, const Point& max);
+		size_t bucket = 0;
+		while ((size_t(2) << bucket) <= node.count)
+		{
+			++bucket;
+		}
 
-	LOctantNode<T>* split(const Point& data_point, LOctantNode<T>* currnode, const Point& min, const const Point& max, int& depth);
+		if (result.occupancy.size() <= bucket)
+		{
+			result.occupancy.resize(bucket + 1, 0);
+		}
+		++result.occupancy[bucket];
+	});
 
-	// bit operations
-	void set_8bit_mut(uint8_t& input, size_t index, bool val);
-	void set_32bit_mut(uint32_t& input, size_t index, bool val);
-	uint8_t set_8bit(const uint8_t& input, size_t index, bool val);
-	uint32_t set_32bit(const uint32_t& input, size_t index, bool val);
-	uint32_t shift_left(const uint32_t& input, size_t count);
-	uint32_t shift_right(const uint32_t& input, size_t count);
-	bool is_bit_set_8bit(const uint8_t& flag, size_t index);
-};
+	for (const auto& [code, proxy] : d_proxies)
+	{
+		++result.proxy_count;
+		result.proxy_bytes += sizeof(code) + sizeof(proxy) + proxy.elements.capacity() * sizeof(T);
+	}
 
+	result.node_bytes = d_nodes.memory_bytes();
+	result.payload_bytes = d_pool.memory_bytes();
+	result.free_slots = d_pool.free_slots();
+	result.bytes = sizeof(*this) + result.node_bytes + result.payload_bytes + result.proxy_bytes;
+	return result;
+}
 
-template<class T>
-inline LinearOctree<T>::LinearOctree(const Point& min, float side_length, size_t max_depth, size_t max_element_per_leaf_node)
-	: d_min(min)
-	, d_max(min.x + side_length, min.y + side_length, min.z + side_length)
-	, d_max_depth(max_depth)
-	, d_max_element_per_node(max_element_per_leaf_node)
+template<class T, class Code, class Storage>
+inline size_t LinearOctree<T, Code, Storage>::code_depth(Code locCode) const
 {
-	assert(d_max_depth <= 10);
+	assert(locCode);
+	// for (uint32_t lc=node->LocCode, depth=0; lc!=1; lc>>=3, depth++);
+	// return depth;
+
+#if defined(__GNUC__)
+	if constexpr (sizeof(Code) == 8)
+	{
+		return (63 - __builtin_clzll(locCode)) / 3;
+	}
+	else
+	{
+		return (31 - __builtin_clz(locCode)) / 3;
+	}
+#elif defined(_MSC_VER)
+	unsigned long msb;
+	if constexpr (sizeof(Code) == 8)
+	{
+		_BitScanReverse64(&msb, locCode);
+	}
+	else
+	{
+		_BitScanReverse(&msb, locCode);
+	}
+	return msb / 3;
+#endif
 }
 
-template<class T>
-inline LinearOctree<T>::~LinearOctree()
+template<class T, class Code, class Storage>
+inline Code LinearOctree<T, Code, Storage>::code_of(const Point& p, size_t depth) const
 {
-	clear();
+	assert(depth <= d_max_depth);
+	const uint32_t cells = 1u << depth;
+	const Point cell = (p - d_min) * (Point((float)cells) / (d_max - d_min));
+
+	const uint32_t x = std::min((uint32_t)std::max(cell.x, 0.0f), cells - 1);
+	const uint32_t y = std::min((uint32_t)std::max(cell.y, 0.0f), cells - 1);
+	const uint32_t z = std::min((uint32_t)std::max(cell.z, 0.0f), cells - 1);
+	return (Code(1) << (3 * depth)) | morton_encode<Code>(x, y, z);
 }
 
-template<class T>
-inline bool LinearOctree<T>::traverse(Callback callback)
+template<class T, class Code, class Storage>
+inline size_t LinearOctree<T, Code, Storage>::fit_depth(const Point& box_min, const Point& box_max) const
 {
-	assert(callback);
+	const Point extent = box_max - box_min;
+	const float max_extent = std::max(std::max(extent.x, extent.y), extent.z);
 
-	if (d_nodes.empty())
+	if (max_extent <= 0.0f)
 	{
-		return false;
+		return d_max_depth;
 	}
 
-	traverseRecursive(callback, d_min, d_max, &d_nodes[ROOT_CODE]);
-	return true;
+	// a node of size s holds a box centered inside it while the box extent is <= (looseness - 1) * s
+	const float fit = std::floor(std::log2((d_looseness - 1.0f) * (d_max.x - d_min.x) / max_extent));
+	return (size_t)std::min((float)d_max_depth, std::max(0.0f, fit));
 }
 
-template<class T>
-inline void LinearOctree<T>::clear()
+template<class T, class Code, class Storage>
+inline LOctantNode<T, Code>* LinearOctree<T, Code, Storage>::create_path(Code locCode)
 {
-	d_nodes.clear();
+	const size_t depth = code_depth(locCode);
+	auto* node = root_node();
+
+	for (size_t level = 1; level <= depth; ++level)
+	{
+		const LOctant octant = (LOctant)((locCode >> (3 * (depth - level))) & 7);
+		node = get_node_from(node, octant);
+	}
+
+	return node;
 }
 
-template<class T>
-inline std::vector<T>& LinearOctree<T>::push(const Point& data_point, ErrorCode& error, Callback callback)
+template<class T, class Code, class Storage>
+inline T& LinearOctree<T, Code, Storage>::append(LOctantNode<T, Code>* node, const T& element)
 {
-	static std::vector<T> dummy;
-
-	if (!is_inside(data_point, d_min, d_max))
+	if (node->count == node->capacity)
 	{
-		error = PUSH_ERROR_DATAPOINT_OUT_OF_RANGE;
-		return dummy;
+		// double the block, built leaves have no slack so their first insert moves them too
+		d_pool.grow(node->first, node->count, node->capacity, std::max<uint32_t>(1, node->count * 2));
 	}
 
-	int depth = 0;
-	return *(split(data_point, root_node(), d_min, d_max, depth)->data);
+	T& slot = d_pool[node->first + node->count];
+	slot = element;
+	++node->count;
+	return slot;
 }
 
-template<class T>
-inline size_t LinearOctree<T>::node_depth(const LOctantNode<T>* node)
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::collapse(Code locCode)
 {
-	assert(node && node->locCode); // at least flag bit must be set
-	// for (uint32_t lc=node->LocCode, depth=0; lc!=1; lc>>=3, depth++);
-	// return depth;
+	// drop empty childless nodes bottom up, clearing their bit in the parent. the root stays.
+	while (locCode != ROOT_CODE)
+	{
+		auto* node = LookupNode(locCode);
+		if (!node || node->childrenFlags != 0 || node->count != 0)
+		{
+			return;
+		}
 
-#if defined(__GNUC__)
-	return (31 - __builtin_clz(node->loc_code)) / 3;
-#elif defined(_MSC_VER)
-	unsigned long msb;
-	_BitScanReverse(&msb, node->locCode);
-	return msb / 3;
-#endif
+		d_nodes.erase(locCode);
+
+		const Code parentCode = locCode >> 3;
+		auto* parent = LookupNode(parentCode);
+		assert(parent);
+		set_8bit_mut(parent->childrenFlags, (size_t)(locCode & 7), false);
+		locCode = parentCode;
+	}
 }
 
-template<class T>
-inline LOctantNode<T>* LinearOctree<T>::parent_node(const LOctantNode<T>* node)
+template<class T, class Code, class Storage>
+inline LOctantNode<T, Code>* LinearOctree<T, Code, Storage>::LookupNode(Code locCode)
 {
-	assert(node);
-	const uint32_t locCodeParent = (node->locCode >> 3);
-	return LookupNode(locCodeParent);
+	return d_nodes.find(locCode);
 }
 
-template<class T>
-inline bool LinearOctree<T>::is_leaf(const LOctantNode<T>* node)
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::cullRecursive(const camera::Frustum& frustum, const Point& curr_min, const Point& curr_max, LOctantNode<T, Code>* curr_node, std::vector<std::span<T>>& out)
 {
-	assert(node);
-	return node->childrenFlags == 0 ? true : false;
+	if (!curr_node)
+	{
+		return;
+	}
+
+	Point loose_min, loose_max;
+	loose_bounds(curr_min, curr_max, loose_min, loose_max);
+	const camera::Visibility visibility = frustum.classify(loose_min, loose_max);
+
+	if (visibility == camera::VISIBILITY_OUTSIDE)
+	{
+		return;
+	}
+
+	if (visibility == camera::VISIBILITY_INSIDE)
+	{
+		collectRecursive(curr_node, out);
+		return;
+	}
+
+	if (curr_node->count != 0)
+	{
+		out.push_back(node_data(curr_node));
+	}
+
+	const Point half_delta = (curr_max - curr_min) * 0.5f;
+
+	for (int i = 0; i < LOctant::OCTANT_SIZE; ++i)
+	{
+		if (curr_node->childrenFlags & (1 << i))
+		{
+			int x = i % 2, z = (i / 2) % 2, y = i / (2 * 2);
+
+			auto next_min = curr_min + half_delta * Point(x, y, z);
+			auto next_max = next_min + half_delta;
+			cullRecursive(frustum, next_min, next_max, LookupNode((curr_node->locCode << 3) | i), out);
+		}
+	}
 }
 
-template<class T>
-inline bool LinearOctree<T>::is_valid_node(LOctantNode<T>* node)
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::collectRecursive(LOctantNode<T, Code>* curr_node, std::vector<std::span<T>>& out)
 {
-	assert(node);
-	return (node->childrenFlags == 0 && node->data != nullptr || node->childrenFlags != 0 && node->data == nullptr) ? true : false;
+	if (!curr_node)
+	{
+		return;
+	}
+
+	if (curr_node->count != 0)
+	{
+		out.push_back(node_data(curr_node));
+	}
+
+	for (int i = 0; i < LOctant::OCTANT_SIZE; ++i)
+	{
+		if (curr_node->childrenFlags & (1 << i))
+		{
+			collectRecursive(LookupNode((curr_node->locCode << 3) | i), out);
+		}
+	}
 }
 
-template<class T>
-inline void LinearOctree<T>::linearProcess(std::function<void(LOctantNode<T>&)> callback, bool only_data_node)
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::lodRecursive(const camera::Frustum& frustum, const Point& eye, float pixel_scale, float max_pixel_error, bool inside,
+	const Point& curr_min, const Point& curr_max, LOctantNode<T, Code>* curr_node, std::vector<std::span<T>>& out)
 {
-	if (only_data_node)
+	if (!curr_node)
+	{
+		return;
+	}
+
+	if (!inside)
+	{
+		Point loose_min, loose_max;
+		loose_bounds(curr_min, curr_max, loose_min, loose_max);
+		const camera::Visibility visibility = frustum.classify(loose_min, loose_max);
+
+		if (visibility == camera::VISIBILITY_OUTSIDE)
+		{
+			return;
+		}
+		inside = visibility == camera::VISIBILITY_INSIDE;
+	}
+
+	if (!d_proxies.empty())
 	{
-		for (auto& elem : d_nodes)
+		auto found = d_proxies.find(curr_node->locCode);
+
+		// error * pixel_scale / distance <= max_pixel_error, with the eye inside the node only exact proxies pass
+		if (found != d_proxies.end() &&
+			found->second.error * pixel_scale <= max_pixel_error * std::sqrt(distance2_to_box(eye, curr_min, curr_max)))
 		{
-			if (is_leaf(&elem.second))
+			if (!found->second.elements.empty())
 			{
-				callback(elem.second);
+				out.push_back(std::span<T>(found->second.elements));
 			}
+			return;
 		}
 	}
-	else
+
+	if (curr_node->count != 0)
+	{
+		out.push_back(node_data(curr_node));
+	}
+
+	const Point half_delta = (curr_max - curr_min) * 0.5f;
+
+	for (int i = 0; i < LOctant::OCTANT_SIZE; ++i)
 	{
-		for (auto& elem : d_nodes)
+		if (curr_node->childrenFlags & (1 << i))
 		{
-			callback(elem.second);
+			int x = i % 2, z = (i / 2) % 2, y = i / (2 * 2);
+
+			auto next_min = curr_min + half_delta * Point(x, y, z);
+			auto next_max = next_min + half_delta;
+			lodRecursive(frustum, eye, pixel_scale, max_pixel_error, inside, next_min, next_max, LookupNode((curr_node->locCode << 3) | i), out);
 		}
 	}
 }
 
-template<class T>
-inline LOctantNode<T>* LinearOctree<T>::LookupNode(uint32_t locCode)
-{
-	return d_nodes.count(locCode) == 0 ? nullptr : &d_nodes[locCode];
-}
-
-template<class T>
-inline void LinearOctree<T>::traverseRecursive(Callback callback, const Point& curr_min, const Point& curr_max, const LOctantNode<T>* curr_node)
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::raycastRecursive(const Point& origin, const Point& inv_dir, uint32_t dir_mask, const Point& curr_min, const Point& curr_max,
+	LOctantNode<T, Code>* curr_node, RayCallback& callback, float& best_t)
 {
 	if (!curr_node)
 	{
-		return;
+		return false;
 	}
 
-	if (callback == nullptr)
+	bool hit = false;
+
+	if (curr_node->count != 0)
 	{
-		return;
+		hit = callback(node_data(curr_node), best_t);
+	}
+
+	const Point half_delta = (curr_max - curr_min) * 0.5f;
+
+	for (uint32_t i = 0; i < LOctant::OCTANT_SIZE; ++i)
+	{
+		const uint32_t octant = i ^ dir_mask;
+
+		if (!(curr_node->childrenFlags & (1 << octant)))
+		{
+			continue;
+		}
+
+		int x = octant % 2, z = (octant / 2) % 2, y = octant / (2 * 2);
+
+		auto next_min = curr_min + half_delta * Point(x, y, z);
+		auto next_max = next_min + half_delta;
+
+		float t_enter;
+		if (!intersect_ray(origin, inv_dir, next_min, next_max, best_t, t_enter))
+		{
+			continue;
+		}
+
+		hit |= raycastRecursive(origin, inv_dir, dir_mask, next_min, next_max, LookupNode((curr_node->locCode << 3) | octant), callback, best_t);
 	}
 
-	if (!callback(curr_min, curr_max, curr_node->data ? curr_node->data.get() : nullptr))
+	return hit;
+}
+
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::intersect_ray(const Point& origin, const Point& inv_dir, const Point& min, const Point& max, float max_t, float& t_enter)
+{
+	// node bounds, widened in loose mode
+	Point loose_min, loose_max;
+	loose_bounds(min, max, loose_min, loose_max);
+
+	const Point t0 = (loose_min - origin) * inv_dir;
+	const Point t1 = (loose_max - origin) * inv_dir;
+	const Point t_near = glm::min(t0, t1);
+	const Point t_far = glm::max(t0, t1);
+
+	t_enter = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+	const float t_exit = std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, max_t));
+	return t_enter <= t_exit;
+}
+
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::radiusRecursive(const Point& p, float r2, const Point& curr_min, const Point& curr_max, LOctantNode<T, Code>* curr_node,
+	const PositionFn& position_of, std::vector<Neighbor>& out)
+{
+	if (!curr_node)
 	{
 		return;
 	}
 
+	for (auto& elem : node_data(curr_node))
+	{
+		const Point delta = position_of(elem) - p;
+		const float d2 = glm::dot(delta, delta);
 
-	Point delta = curr_max - curr_min;
-	Point half_delta = (delta * 0.5f);
+		if (d2 <= r2)
+		{
+			out.push_back({ &elem, d2 });
+		}
+	}
+
+	const Point half_delta = (curr_max - curr_min) * 0.5f;
 
 	for (int i = 0; i < LOctant::OCTANT_SIZE; ++i)
 	{
 		if (curr_node->childrenFlags & (1 << i))
 		{
-			const uint32_t locCodeChild = (curr_node->locCode << 3) | i;
-			const auto* child = LookupNode(locCodeChild);
-
 			int x = i % 2, z = (i / 2) % 2, y = i / (2 * 2);
 
-			auto next_min = curr_min + half_delta * glm::vec3(x, y, z);
+			auto next_min = curr_min + half_delta * Point(x, y, z);
 			auto next_max = next_min + half_delta;
-			traverseRecursive(callback, next_min, next_max, child);
+
+			if (distance2_to_box(p, next_min, next_max) <= r2)
+			{
+				radiusRecursive(p, r2, next_min, next_max, LookupNode((curr_node->locCode << 3) | i), position_of, out);
+			}
 		}
 	}
+}
+
+template<class T, class Code, class Storage>
+inline float LinearOctree<T, Code, Storage>::distance2_to_box(const Point& p, const Point& min, const Point& max)
+{
+	// node bounds, widened in loose mode
+	Point loose_min, loose_max;
+	loose_bounds(min, max, loose_min, loose_max);
 
+	const Point delta = glm::max(glm::max(loose_min - p, Point(0.0f)), p - loose_max);
+	return glm::dot(delta, delta);
 }
 
-template<class T>
-inline LOctantNode<T>* LinearOctree<T>::root_node()
+template<class T, class Code, class Storage>
+inline LOctantNode<T, Code>* LinearOctree<T, Code, Storage>::root_node()
 {
 	if (!d_nodes.empty())
 	{
-		return &d_nodes[ROOT_CODE];
+		return d_nodes.find(ROOT_CODE);
 	}
 
-	d_nodes[ROOT_CODE].locCode = ROOT_CODE;
-	d_nodes[ROOT_CODE].childrenFlags = 0;
-	d_nodes[ROOT_CODE].data = nullptr;
-	return &d_nodes[ROOT_CODE];
+	auto& root = d_nodes.insert(ROOT_CODE);
+	root.childrenFlags = 0;
+	return &root;
 }
 
-template<class T>
-inline LOctantNode<T>* LinearOctree<T>::get_node_from(LOctantNode<T>* parent, LOctant octant, bool isLeaf)
+template<class T, class Code, class Storage>
+inline LOctantNode<T, Code>* LinearOctree<T, Code, Storage>::get_node_from(LOctantNode<T, Code>* parent, LOctant octant)
 {
 	// TODO:
-	uint32_t childCode = shift_left(parent->locCode, 3);
-	childCode |= ((uint32_t)octant);
+	Code childCode = shift_left(parent->locCode, 3);
+	childCode |= ((Code)octant);
 
 	if (is_bit_set_8bit(parent->childrenFlags, (size_t)octant))
 	{
-		assert(d_nodes.count(childCode));
-		return &d_nodes[childCode];
+		assert(d_nodes.find(childCode));
+		return d_nodes.find(childCode);
 	}
 
-	assert(d_nodes.count(childCode) == 0);
-	d_nodes[childCode].locCode = childCode;
-	d_nodes[childCode].childrenFlags = 0;
+	assert(d_nodes.find(childCode) == nullptr);
 
+	// flag the parent first, inserting may move the nodes of a flat storage
 	set_8bit_mut(parent->childrenFlags, octant, true);
 
-	if (isLeaf)
-	{
-		d_nodes[childCode].data = std::make_unique<std::vector<T>>();
-	}
-
-	return &d_nodes[childCode];
+	auto& child = d_nodes.insert(childCode);
+	child.childrenFlags = 0;
+	return &child;
 }
 
-template<class T>
-inline bool LinearOctree<T>::is_inside(const Point& sample, const Point& min, const Point& max)
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::is_inside(const Point& sample, const Point& min, const Point& max)
 {
 	return
 		(sample.x >= min.x &&
@@ -306,8 +1707,8 @@ inline bool LinearOctree<T>::is_inside(const Point& sample, const Point& min, co
 
 }
 
-template<class T>
-inline LOctantNode<T>* LinearOctree<T>::split(const Point& data_point, LOctantNode<T>* currnode, const Point& curr_min, const const Point& curr_max, int& depth)
+template<class T, class Code, class Storage>
+inline LOctantNode<T, Code>* LinearOctree<T, Code, Storage>::split(const Point& data_point, LOctantNode<T, Code>* currnode, const Point& curr_min, const Point& curr_max, int& depth)
 {
 	if (!currnode)
 	{
@@ -316,14 +1717,13 @@ inline LOctantNode<T>* LinearOctree<T>::split(const Point& data_point, LOctantNo
 
 	if (node_depth(currnode) == d_max_depth)
 	{
-		assert(currnode->data);
 		return currnode;
 	}
 
 	Point delta = curr_max - curr_min;
 	Point half_delta = (delta * 0.5f);
 
-	LOctantNode<T>* data_node = nullptr;
+	LOctantNode<T, Code>* data_node = nullptr;
 
 	for (int i = 0; i < LOctant::OCTANT_SIZE; ++i)
 	{
@@ -337,7 +1737,7 @@ inline LOctantNode<T>* LinearOctree<T>::split(const Point& data_point, LOctantNo
 
 			//TODO: created
 
-			auto next_node = get_node_from(currnode, (LOctant)i, depth == d_max_depth ? true : false);
+			auto next_node = get_node_from(currnode, (LOctant)i);
 			data_node = split(data_point, next_node, next_min, next_max, depth);
 			break;
 		}
@@ -349,70 +1749,87 @@ inline LOctantNode<T>* LinearOctree<T>::split(const Point& data_point, LOctantNo
 
 
 // bit operations
-template<class T>
-inline void LinearOctree<T>::set_8bit_mut(uint8_t& input, size_t index, bool val)
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::set_8bit_mut(uint8_t& input, size_t index, bool val)
 {
-	input = *((uint8_t*)& std::bitset<8>(input).set(index, val));
+	input = set_8bit(input, index, val);
 }
 
-template<class T>
-inline void LinearOctree<T>::set_32bit_mut(uint32_t& input, size_t index, bool val)
+template<class T, class Code, class Storage>
+inline void LinearOctree<T, Code, Storage>::set_code_bit_mut(Code& input, size_t index, bool val)
 {
-	input = *((uint32_t*)& std::bitset<32>(input).set(index, val));
+	input = set_code_bit(input, index, val);
 }
 
-template<class T>
-inline uint8_t LinearOctree<T>::set_8bit(const uint8_t& input, size_t index, bool val)
+template<class T, class Code, class Storage>
+inline uint8_t LinearOctree<T, Code, Storage>::set_8bit(const uint8_t& input, size_t index, bool val)
 {
-	std::bitset<8> wrapper(input);
-	wrapper.set(index, val);
-	return *((uint8_t*)& wrapper);
+	assert(index < 8);
+	const uint8_t mask = (uint8_t)(1u << index);
+	return val ? (uint8_t)(input | mask) : (uint8_t)(input & ~mask);
 }
 
-template<class T>
-inline uint32_t LinearOctree<T>::set_32bit(const uint32_t& input, size_t index, bool val)
+template<class T, class Code, class Storage>
+inline Code LinearOctree<T, Code, Storage>::set_code_bit(const Code& input, size_t index, bool val)
 {
-	std::bitset<32> wrapper(input);
-	wrapper.set(index, val);
-	return *((uint32_t*)& wrapper);
+	assert(index < sizeof(Code) * 8);
+	const Code mask = Code(1) << index;
+	return val ? (input | mask) : (input & ~mask);
 }
 
-template<class T>
-inline uint32_t LinearOctree<T>::shift_left(const uint32_t& input, size_t count)
+template<class T, class Code, class Storage>
+inline Code LinearOctree<T, Code, Storage>::shift_left(const Code& input, size_t count)
 {
-	std::bitset<32> bitsample(input);
-	bitsample <<= count;
-	return *((uint32_t*)& bitsample);
+	return count < sizeof(Code) * 8 ? (Code)(input << count) : Code(0);
 }
 
-template<class T>
-inline uint32_t LinearOctree<T>::shift_right(const uint32_t& input, size_t count)
+template<class T, class Code, class Storage>
+inline Code LinearOctree<T, Code, Storage>::shift_right(const Code& input, size_t count)
 {
-	std::bitset<32> bitsample(input);
-	bitsample >>= count;
-	return *((uint32_t*)& bitsample);
+	return count < sizeof(Code) * 8 ? (Code)(input >> count) : Code(0);
 }
 
-template<class T>
-inline bool LinearOctree<T>::is_bit_set_8bit(const uint8_t& flag, size_t index)
+template<class T, class Code, class Storage>
+inline bool LinearOctree<T, Code, Storage>::is_bit_set_8bit(const uint8_t& flag, size_t index)
 {
-	std::bitset<8> wrapper(flag);
-	return wrapper[index];
+	return (flag >> index) & 1u;
 }
 
-// sample data node
+// sample data node, one indexed draw from a range of an index buffer that may be shared by many draws
 struct DrawMeshData
 {
 	std::size_t vbo_offset;
 	std::shared_ptr<vkapi::BufferObject> vbo;
 	std::shared_ptr<vkapi::BufferObject> ibo;
-	std::vector<uint32_t> ibo_host;
+	std::size_t mesh_index = 0;
+	std::size_t draw_first_index = 0;
 	std::size_t draw_index_count;
 	std::size_t draw_instance_first_index = 0;
 	std::size_t draw_instance_count = 1;
 };
 
+// sample data node without owning references, trivially copyable so a tree of them can be saved and mapped.
+// the owner of the tree resolves buffer, and the vertex range of mesh_index, to its own buffers.
+struct DrawRecord
+{
+	uint32_t mesh_index = 0;
+	uint32_t buffer = 0;
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+
+	bool operator==(const DrawRecord&) const = default;
+};
+
+// read only tree answering queries from a file written by LinearOctree::save
+template <class T, class Code = uint32_t>
+using MappedLinearOctree = LinearOctree<T, Code, MappedNodeStorage<LOctantNode<T, Code>>>;
+
 using DrawMeshOctree = LinearOctree<DrawMeshData>;
 using DrawMeshNode = LOctantNode<DrawMeshData>;
+using DrawRecordOctree = LinearOctree<DrawRecord>;
+using MappedDrawRecordOctree = MappedLinearOctree<DrawRecord>;
+
+static_assert(SpatialQuery<DrawMeshOctree>);
+static_assert(SpatialQuery<MappedDrawRecordOctree>);
 
 }// end namespace octree
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <assert.h>
+#include "../util/parallel.h"
+
+namespace octree
+{
+
+// Morton (z-order) helpers shared by the octree bulk paths.
+// Octant bits follow LOctant: bit 0 = x, bit 1 = z, bit 2 = y.
+
+// inserts two zero bits between each of the low 10 bits of v
+inline uint32_t morton_spread3(uint32_t v)
+{
+	v &= 0x000003ff;
+	v = (v | (v << 16)) & 0xff0000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// inserts two zero bits between each of the low 21 bits of v
+inline uint64_t morton_spread3_64(uint64_t v)
+{
+	v &= 0x1fffff;
+	v = (v | (v << 32)) & 0x001f00000000ffffull;
+	v = (v | (v << 16)) & 0x001f0000ff0000ffull;
+	v = (v | (v << 8)) & 0x100f00f00f00f00full;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+	v = (v | (v << 2)) & 0x1249249249249249ull;
+	return v;
+}
+
+// interleaves cell coordinates into octant order, depth * 3 bits (no flag bit)
+template <class Code>
+inline Code morton_encode(uint32_t x, uint32_t y, uint32_t z)
+{
+	if constexpr (sizeof(Code) == 8)
+	{
+		return morton_spread3_64(x) | (morton_spread3_64(z) << 1) | (morton_spread3_64(y) << 2);
+	}
+	else
+	{
+		return morton_spread3(x) | (morton_spread3(z) << 1) | (morton_spread3(y) << 2);
+	}
+}
+
+template <class Code>
+struct MortonKey
+{
+	Code code;
+	uint32_t index;
+};
+
+// stable parallel LSD radix sort on the low key_bits of MortonKey::code, 8 bits per pass
+template <class Code>
+inline void radix_sort(std::vector<MortonKey<Code>>& keys, unsigned key_bits)
+{
+	const size_t RADIX = 256;
+	const size_t count = keys.size();
+	const size_t chunks = util::Parallel::chunkCount(count);
+
+	std::vector<MortonKey<Code>> scratch(count);
+	std::vector<size_t> histogram(chunks * RADIX);
+
+	for (unsigned shift = 0; shift < key_bits; shift += 8)
+	{
+		std::fill(histogram.begin(), histogram.end(), size_t(0));
+
+		util::Parallel::forEachChunk(count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+			size_t* hist = &histogram[chunk * RADIX];
+			for (size_t i = begin; i < end; ++i)
+			{
+				++hist[(size_t)(keys[i].code >> shift) & (RADIX - 1)];
+			}
+		});
+
+		// turn counts into scatter offsets, digit major so equal digits keep chunk order
+		size_t offset = 0;
+		size_t used_digits = 0;
+		for (size_t digit = 0; digit < RADIX; ++digit)
+		{
+			size_t digit_count = 0;
+			for (size_t chunk = 0; chunk < chunks; ++chunk)
+			{
+				const size_t c = histogram[chunk * RADIX + digit];
+				histogram[chunk * RADIX + digit] = offset;
+				offset += c;
+				digit_count += c;
+			}
+			used_digits += digit_count ? 1 : 0;
+		}
+
+		if (used_digits <= 1)
+		{
+			continue; // every key shares this digit
+		}
+
+		util::Parallel::forEachChunk(count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+			size_t* offsets = &histogram[chunk * RADIX];
+			for (size_t i = begin; i < end; ++i)
+			{
+				scratch[offsets[(size_t)(keys[i].code >> shift) & (RADIX - 1)]++] = keys[i];
+			}
+		});
+
+		keys.swap(scratch);
+	}
+}
+
+}// end namespace octree
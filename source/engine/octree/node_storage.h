@@ -0,0 +1,344 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <assert.h>
+
+namespace octree
+{
+
+// Node storages for LinearOctree. A storage maps a locational code to its node and
+// must provide: find, insert, erase, clear, size, empty, reserve, for_each and memory_bytes.
+// Node pointers handed out by a storage are only valid until the next insert or erase.
+
+// node based hash map, one heap allocation per node.
+template <class Node>
+class MapNodeStorage
+{
+public:
+	using node_type = Node;
+	using code_type = decltype(Node::locCode);
+
+	Node* find(code_type code)
+	{
+		auto it = d_nodes.find(code);
+		return it == d_nodes.end() ? nullptr : &it->second;
+	}
+
+	const Node* find(code_type code) const
+	{
+		auto it = d_nodes.find(code);
+		return it == d_nodes.end() ? nullptr : &it->second;
+	}
+
+	Node& insert(code_type code)
+	{
+		assert(code != 0);
+		auto& node = d_nodes[code];
+		node.locCode = code;
+		return node;
+	}
+
+	bool erase(code_type code)
+	{
+		return d_nodes.erase(code) != 0;
+	}
+
+	void clear()
+	{
+		d_nodes.clear();
+	}
+
+	void reserve(size_t count)
+	{
+		d_nodes.reserve(count);
+	}
+
+	size_t size() const
+	{
+		return d_nodes.size();
+	}
+
+	bool empty() const
+	{
+		return d_nodes.empty();
+	}
+
+	template <class Fn>
+	void for_each(Fn&& fn)
+	{
+		for (auto& elem : d_nodes)
+		{
+			fn(elem.second);
+		}
+	}
+
+	size_t memory_bytes() const
+	{
+		// bucket array plus one list node (key, value, next pointer) per entry
+		return d_nodes.bucket_count() * sizeof(void*) +
+			d_nodes.size() * (sizeof(code_type) + sizeof(Node) + sizeof(void*));
+	}
+
+private:
+	std::unordered_map<code_type, Node> d_nodes;
+};
+
+
+// open addressing table stored in one contiguous array.
+// The slot of a node is hash(parent code) * 8 + octant, so the eight children of a node
+// land next to each other and a traversal touches consecutive memory. Collisions are
+// resolved by linear probing. Slots with locCode == 0 are empty (a valid code always carries its flag bit).
+template <class Node>
+class FlatNodeStorage
+{
+public:
+	using node_type = Node;
+	using code_type = decltype(Node::locCode);
+
+	Node* find(code_type code)
+	{
+		return const_cast<Node*>(static_cast<const FlatNodeStorage*>(this)->find(code));
+	}
+
+	const Node* find(code_type code) const
+	{
+		if (d_count == 0 || code == 0)
+		{
+			return nullptr;
+		}
+
+		for (size_t i = home_slot(code);; i = (i + 1) & d_mask)
+		{
+			const code_type slotCode = d_slots[i].locCode;
+			if (slotCode == code)
+			{
+				return &d_slots[i];
+			}
+
+			if (slotCode == 0)
+			{
+				return nullptr;
+			}
+		}
+	}
+
+	Node& insert(code_type code)
+	{
+		assert(code != 0);
+
+		if ((d_count + 1) * 2 > d_slots.size())
+		{
+			rehash(d_slots.empty() ? MIN_CAPACITY : d_slots.size() * 2);
+		}
+
+		size_t i = home_slot(code);
+		while (d_slots[i].locCode != 0)
+		{
+			assert(d_slots[i].locCode != code);
+			i = (i + 1) & d_mask;
+		}
+
+		d_slots[i] = Node();
+		d_slots[i].locCode = code;
+		++d_count;
+		return d_slots[i];
+	}
+
+	bool erase(code_type code)
+	{
+		Node* node = find(code);
+		if (!node)
+		{
+			return false;
+		}
+
+		// backward shift deletion: pull later entries of the probe chain into the hole
+		// unless their home slot lies cyclically in (hole, j]
+		size_t hole = (size_t)(node - d_slots.data());
+		for (size_t j = (hole + 1) & d_mask; d_slots[j].locCode != 0; j = (j + 1) & d_mask)
+		{
+			const size_t home = home_slot(d_slots[j].locCode);
+			const bool stays = hole <= j ? (hole < home && home <= j) : (hole < home || home <= j);
+			if (!stays)
+			{
+				d_slots[hole] = std::move(d_slots[j]);
+				hole = j;
+			}
+		}
+
+		d_slots[hole] = Node();
+		--d_count;
+		return true;
+	}
+
+	void clear()
+	{
+		d_slots.clear();
+		d_slots.shrink_to_fit();
+		d_count = 0;
+		d_mask = 0;
+		d_shift = 0;
+	}
+
+	void reserve(size_t count)
+	{
+		size_t capacity = MIN_CAPACITY;
+		while (capacity < count * 2)
+		{
+			capacity *= 2;
+		}
+
+		if (capacity > d_slots.size())
+		{
+			rehash(capacity);
+		}
+	}
+
+	size_t size() const
+	{
+		return d_count;
+	}
+
+	bool empty() const
+	{
+		return d_count == 0;
+	}
+
+	template <class Fn>
+	void for_each(Fn&& fn)
+	{
+		for (auto& slot : d_slots)
+		{
+			if (slot.locCode != 0)
+			{
+				fn(slot);
+			}
+		}
+	}
+
+	size_t memory_bytes() const
+	{
+		return d_slots.capacity() * sizeof(Node);
+	}
+
+private:
+	static constexpr size_t MIN_CAPACITY = 64;
+
+	std::vector<Node> d_slots;
+	size_t d_count = 0;
+	size_t d_mask = 0;
+	uint32_t d_shift = 0;
+
+	size_t home_slot(code_type code) const
+	{
+		// fibonacci hashing of the parent code picks a block of 8 slots, the octant picks the slot inside it
+		const uint64_t parent = (uint64_t)(code >> 3);
+		const uint64_t block = (parent * 0x9E3779B97F4A7C15ull) >> d_shift;
+		return (size_t)((block << 3) | (uint64_t)(code & 7)) & d_mask;
+	}
+
+	void rehash(size_t capacity)
+	{
+		assert((capacity & (capacity - 1)) == 0 && capacity >= MIN_CAPACITY);
+
+		std::vector<Node> old;
+		old.swap(d_slots);
+
+		d_slots.resize(capacity);
+		d_mask = capacity - 1;
+
+		uint32_t bits = 0;
+		while ((size_t(1) << bits) < capacity)
+		{
+			++bits;
+		}
+		d_shift = 64 - (bits - 3);
+
+		for (auto& node : old)
+		{
+			if (node.locCode == 0)
+			{
+				continue;
+			}
+
+			size_t i = home_slot(node.locCode);
+			while (d_slots[i].locCode != 0)
+			{
+				i = (i + 1) & d_mask;
+			}
+			d_slots[i] = std::move(node);
+		}
+	}
+};
+
+
+// read only view over nodes sorted by locational code, as written by LinearOctree::save.
+// A code at depth d lies in [8^d, 2 * 8^d), so the array is in level order and the children
+// of a node are adjacent. find is a binary search, there is no insert or erase: a tree
+// using this storage is filled by LinearOctree::map and only answers queries.
+template <class Node>
+class MappedNodeStorage
+{
+public:
+	using node_type = Node;
+	using code_type = decltype(Node::locCode);
+
+	void attach(Node* nodes, size_t count)
+	{
+		d_nodes = nodes;
+		d_count = count;
+	}
+
+	Node* find(code_type code)
+	{
+		return const_cast<Node*>(static_cast<const MappedNodeStorage*>(this)->find(code));
+	}
+
+	const Node* find(code_type code) const
+	{
+		const Node* begin = d_nodes;
+		const Node* end = d_nodes + d_count;
+		const Node* it = std::lower_bound(begin, end, code, [](const Node& node, code_type c) { return node.locCode < c; });
+		return (it != end && it->locCode == code) ? it : nullptr;
+	}
+
+	void clear()
+	{
+		d_nodes = nullptr;
+		d_count = 0;
+	}
+
+	size_t size() const
+	{
+		return d_count;
+	}
+
+	bool empty() const
+	{
+		return d_count == 0;
+	}
+
+	template <class Fn>
+	void for_each(Fn&& fn)
+	{
+		for (size_t i = 0; i < d_count; ++i)
+		{
+			fn(d_nodes[i]);
+		}
+	}
+
+	size_t memory_bytes() const
+	{
+		// mapped, not heap
+		return d_count * sizeof(Node);
+	}
+
+private:
+	Node* d_nodes = nullptr;
+	size_t d_count = 0;
+};
+
+}// end namespace octree
@@ -0,0 +1,38 @@
+#pragma once
+#include <concepts>
+#include <span>
+#include <vector>
+#include "../camera/free_camera.h"
+
+namespace octree
+{
+
+// query interface shared by LinearOctree and bvh::TriangleBvh, code constrained on it takes either structure.
+// spans and Neighbor::element point into the payload of the structure and stay valid until it is modified.
+template <class Tree>
+concept SpatialQuery = requires(Tree& tree,
+	const typename Tree::Point& p,
+	std::span<const typename Tree::Point> queries,
+	const camera::FreeCamera& camera,
+	typename Tree::Callback callback,
+	typename Tree::RayCallback ray_callback,
+	const typename Tree::PositionFn& position_of,
+	float value,
+	float& hit_t,
+	size_t k,
+	std::vector<std::span<typename Tree::Element>>& leaves,
+	std::vector<typename Tree::Neighbor>& neighbors,
+	std::vector<std::vector<typename Tree::Neighbor>>& results)
+{
+	{ tree.traverse(callback) } -> std::same_as<bool>;
+	{ tree.cullFrustum(camera, leaves) } -> std::same_as<bool>;
+	{ tree.raycast(p, p, value, ray_callback, hit_t) } -> std::same_as<bool>;
+	{ tree.knn(p, k, position_of, neighbors) } -> std::same_as<void>;
+	{ tree.radius(p, value, position_of, neighbors) } -> std::same_as<void>;
+	{ tree.knn(queries, k, position_of, results) } -> std::same_as<void>;
+	{ tree.radius(queries, value, position_of, results) } -> std::same_as<void>;
+	{ neighbors[0].element } -> std::convertible_to<typename Tree::Element*>;
+	{ neighbors[0].distance2 } -> std::convertible_to<float>;
+};
+
+} // end namespace octree
@@ -1,6 +1,9 @@
 #include "static_model_renderer.h"
 #include <assert.h>
+#include <limits>
+#include <unordered_map>
 #include "../mesh/util.h"
+#include "../util/parallel.h"
 #include "../app/system_mgr.h"
 #include "../debug_draw/debug_draw.hpp"
 
@@ -65,6 +68,31 @@ void StaticModelRenderer::setModel(std::shared_ptr<mesh::StaticModel> model, con
 	//d_mvp.model = transform;
 }
 
+void StaticModelRenderer::setLodThreshold(float max_pixel_error)
+{
+	d_lodPixelError = max_pixel_error;
+}
+
+void StaticModelRenderer::setPartition(size_t leaf_triangles)
+{
+	d_partitionTriangles = leaf_triangles;
+}
+
+void StaticModelRenderer::setCompression(bool compress_vertices)
+{
+	d_compressVertices = compress_vertices;
+}
+
+void StaticModelRenderer::setMeshlets(bool meshlet_culling)
+{
+	d_meshletCulling = meshlet_culling;
+}
+
+void StaticModelRenderer::setTreeFile(const std::string& file)
+{
+	d_treeFile = file;
+}
+
 bool StaticModelRenderer::build(bool clear_host_data)
 {
 	if (!d_input.smodel)
@@ -79,13 +107,41 @@ bool StaticModelRenderer::build(bool clear_host_data)
 	}
 
 	buildIBO();
+
+	d_tree = nullptr;
+	d_mappedTree = nullptr;
+	d_unculled.clear();
+	if (d_treeFile.empty() || !mapTree())
+	{
+		buildTree();
+
+		// ranges the tree rejected are not in the file, such a model is built every time
+		if (!d_treeFile.empty() && d_unculled.empty() && !d_tree->save(d_treeFile))
+		{
+			SDL_Log("could not save the octree to %s", d_treeFile.c_str());
+		}
+	}
+
+	if (d_mappedTree)
+	{
+		buildProxies(*d_mappedTree);
+	}
+	else
+	{
+		buildProxies(*d_tree);
+	}
+
 	buildUBO();
 	buildPipeline();
 
+	d_indexInput.host = std::vector<uint32_t>();
+
 	if (clear_host_data)
 	{
 		d_input.smodel = nullptr;
 	}
+
+	return true;
 }
 
 void StaticModelRenderer::render()
@@ -114,81 +170,182 @@ void StaticModelRenderer::render()
 		nullptr
 	);
 
-	for (int i = 0; i < d_vertexInput.offsets.size(); ++i)
+	if (d_mappedTree)
 	{
-		cmd.bindVertexBuffers(0, d_vertexInput.vbo->buffer, d_vertexInput.offsets[i]);
-		cmd.bindIndexBuffer(d_indexInput.ibos[i]->buffer, 0, vk::IndexType::eUint32);
-		cmd.drawIndexed(d_indexInput.index_count[i], 1, 0, 0, 0);
+		d_mappedTree->cullFrustum(*d_camera, d_viewport.height, d_lodPixelError, d_visible);
+	}
+	else
+	{
+		d_tree->cullFrustum(*d_camera, d_viewport.height, d_lodPixelError, d_visible);
+	}
+
+	if (!d_unculled.empty())
+	{
+		d_visible.push_back(d_unculled);
 	}
 
-	//d_tree->traverse([this](const glm::vec3& min, const glm::vec3& max, std::vector<octree::DrawMeshData>* data) {
+	const camera::Frustum frustum(d_camera->planes());
+	const glm::vec3 eye = d_camera->position();
+	const float pixel_scale = std::abs(d_mvp.proj[1][1]) * d_viewport.height * 0.5f;
+
+	// consecutive ranges mostly share their buffers, only rebind on change.
+	// every mesh has its own range of the one vertex buffer.
+	uint32_t bound_mesh = UINT32_MAX;
+	uint32_t bound_buffer = UINT32_MAX;
+
+	// meshlets of a leaf are neighbours in the index buffer, the visible ones merge into one draw
+	bool pending = false;
+	std::size_t pending_first = 0;
+	std::size_t pending_count = 0;
+	auto flush = [&]() {
+		if (pending)
+		{
+			cmd.drawIndexed(static_cast<uint32_t>(pending_count), 1, static_cast<uint32_t>(pending_first), 0, 0);
+			pending = false;
+		}
+	};
 
-	//	static glm::vec3 color(1.0, 0.0, 0.0);
-	//	dd::aabb(*((ddVec3_In*)& min), *((ddVec3_In*)& max), *((ddVec3_In*)& color));
+	// a mesh picks its level when the first of its ranges is visible, whole or partitioned alike
+	d_meshLod.assign(d_indexInput.lods.size(), LOD_UNPICKED);
 
-	//	if (data)
-	//	{
-	//		auto& stuff = *data;
-	//		for (auto& elem : stuff)
-	//		{
-	//			//cmd.bindVertexBuffers(0, elem.vbo->buffer, elem.vbo_offset);
-	//			//cmd.bindIndexBuffer(elem.ibo->buffer, vk::DeviceSize(0), vk::IndexType::eUint32);
-	//			//cmd.drawIndexed(elem.draw_index_count, 1, 0,/* elem.vbo_offset*/0, 0);
-	//		}
-	//	}
-	//	return true;
-	//});
+	for (auto meshes : d_visible)
+	{
+		for (auto& elem : meshes)
+		{
+			if (!clusterVisible(elem, eye, frustum))
+			{
+				continue;
+			}
+
+			std::size_t first = elem.first_index;
+			std::size_t count = elem.index_count;
+			uint32_t buffer = elem.buffer;
+			if (elem.mesh_index < d_meshLod.size())
+			{
+				auto& lod = d_meshLod[elem.mesh_index];
+				if (lod == LOD_UNPICKED)
+				{
+					lod = pickLod(elem.mesh_index, eye, pixel_scale);
+				}
+
+				if (lod == LOD_DRAWN)
+				{
+					continue;
+				}
+
+				if (lod != LOD_FULL)
+				{
+					// the level covers the whole mesh, it replaces this range, the other leaves and their proxies
+					const auto& level = d_indexInput.lods[elem.mesh_index].levels[lod];
+					first = level.first;
+					count = level.count;
+					buffer = INDEX_BUFFER_MAIN;
+					lod = LOD_DRAWN;
+				}
+			}
+
+			if (pending && buffer == bound_buffer && elem.mesh_index == bound_mesh && first == pending_first + pending_count)
+			{
+				pending_count += count;
+				continue;
+			}
+
+			flush();
+
+			if (elem.mesh_index != bound_mesh)
+			{
+				cmd.bindVertexBuffers(0, d_vertexInput.vbo->buffer, d_vertexInput.offsets[elem.mesh_index]);
+				bound_mesh = elem.mesh_index;
+
+				// a new vertex range is a new mesh and with it new quantization bounds
+				const auto& bounds = d_vertexInput.bounds[elem.mesh_index];
+				PushConstants constants;
+				constants.bounds_min = glm::vec4(bounds.min, 0.0f);
+				constants.bounds_extent = glm::vec4(bounds.extent, 0.0f);
+				cmd.pushConstants(d_ubo.pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstants), &constants);
+			}
+
+			if (buffer != bound_buffer)
+			{
+				const auto& ibo = buffer == INDEX_BUFFER_PROXY ? d_indexInput.proxy_ibo : d_indexInput.ibo;
+				cmd.bindIndexBuffer(ibo->buffer, 0, d_indexInput.type);
+				bound_buffer = buffer;
+			}
+
+			pending = true;
+			pending_first = first;
+			pending_count = count;
+		}
+	}
+
+	flush();
 }
 
 // HELPERS
-bool StaticModelRenderer::buildVBO()
+bool StaticModelRenderer::clusterVisible(const octree::DrawRecord& elem, const glm::vec3& eye, const camera::Frustum& frustum) const
 {
-	std::vector<mesh::Vertex> result;
-	std::vector<mesh::Vertex> tmp;
-	std::size_t offset = 0;
+	const auto& clusters = d_indexInput.clusters;
+	if (clusters.empty() || elem.buffer != INDEX_BUFFER_MAIN)
+	{
+		return true;
+	}
+
+	auto it = std::lower_bound(clusters.begin(), clusters.end(), (size_t)elem.first_index, [](const ClusterBounds& cluster, size_t first) {
+		return cluster.first < first;
+	});
+
+	if (it == clusters.end() || it->first != elem.first_index)
+	{
+		return true;
+	}
+
+	return frustum.intersects(glm::vec3(it->sphere), it->sphere.w) && mesh::coneVisible(it->sphere, it->cone, eye);
+}
 
+bool StaticModelRenderer::buildVBO()
+{
 	for (auto& mesh : d_input.smodel->meshes())
 	{
 		mesh::Utility::transformPointCloud(*mesh, d_input.transform);
 		mesh::Utility::computeNormals(*mesh, true);
-		mesh::Utility::createVertexArray(*mesh, tmp);
+	}
+
+	return d_compressVertices ? interleaveVBO<CompressedVertexFormat>() : interleaveVBO<VertexFormat>();
+}
+
+template <class Format>
+bool StaticModelRenderer::interleaveVBO()
+{
+	std::vector<typename Format::Vertex> result;
+	std::vector<typename Format::Vertex> tmp;
+	std::size_t offset = 0;
+
+	d_vertexInput.offsets.clear();
+	d_vertexInput.bounds.clear();
+
+	for (auto& mesh : d_input.smodel->meshes())
+	{
+		mesh::VertexBounds bounds;
+		tmp.clear();
+
+		// empty meshes keep their slot so offsets stay indexed by mesh, buildIBO skips them
+		if (!mesh->positions.empty() && !mesh->indices.empty() && !Format::interleave(*mesh, tmp, &bounds))
+		{
+			return false;
+		}
 
 		d_vertexInput.offsets.push_back(offset);
+		d_vertexInput.bounds.push_back(bounds);
 		std::copy(tmp.begin(), tmp.end(), std::back_inserter(result));
-		offset += tmp.size() * sizeof(mesh::Vertex);
-	}
-
-	offset = 0;
-	d_vertexInput.inputBinding.binding = 0;
-	d_vertexInput.inputBinding.stride = sizeof(mesh::Vertex);
-	d_vertexInput.inputBinding.inputRate = vk::VertexInputRate::eVertex;
-
-	d_vertexInput.inputAttributes.resize(3);
-	d_vertexInput.inputAttributes[0].binding = 0;
-	d_vertexInput.inputAttributes[0].location = 0;
-	d_vertexInput.inputAttributes[0].format = vk::Format::eR32G32B32Sfloat;
-	d_vertexInput.inputAttributes[0].offset = offset;
-	offset += sizeof(mesh::Position);
-
-	d_vertexInput.inputAttributes[1].binding = 0;
-	d_vertexInput.inputAttributes[1].location = 1;
-	d_vertexInput.inputAttributes[1].format = vk::Format::eR32G32B32Sfloat;
-	d_vertexInput.inputAttributes[1].offset = offset;
-	offset += sizeof(mesh::Normal);
-
-	d_vertexInput.inputAttributes[2].binding = 0;
-	d_vertexInput.inputAttributes[2].location = 2;
-	d_vertexInput.inputAttributes[2].format = vk::Format::eR32G32B32A32Sfloat;
-	d_vertexInput.inputAttributes[2].offset = offset;
-	offset += sizeof(mesh::Color);
-
-	//d_vertexInput.inputAttributes[3].binding = 0;
-	//d_vertexInput.inputAttributes[3].location = 3;
-	//d_vertexInput.inputAttributes[3].format = vk::Format::eR32G32Sfloat;
-	//d_vertexInput.inputAttributes[3].offset = offset;
-	//offset += sizeof(mesh::UV);
-
-	// TODO:
+		offset += tmp.size() * sizeof(typename Format::Vertex);
+	}
+
+	SDL_Log("vertex buffer: %zu vertices, %u bytes each, %zu bytes", result.size(), Format::STRIDE, offset);
+
+	// binding and attributes come from the same declaration as the interleaved data
+	d_vertexInput.inputBinding = Format::binding(0);
+	d_vertexInput.inputAttributes = Format::attributes(0);
+
 	d_vertexInput.vbo = d_vkCtx->createVertexBufferObject(result);
 
 	d_vertexInput.inputState = vk::PipelineVertexInputStateCreateInfo(
@@ -199,56 +356,559 @@ bool StaticModelRenderer::buildVBO()
 		d_vertexInput.inputAttributes.data()
 	);
 
+	return true;
+}
+
+void StaticModelRenderer::buildIBO()
+{
+	auto& meshes = d_input.smodel->meshes();
+	d_indexInput.host.clear();
+	d_indexInput.ranges.clear();
+	d_indexInput.lods.clear();
+	d_indexInput.clusters.clear();
+
+	if (d_meshletCulling)
+	{
+		meshletIBO();
+	}
+	else if (d_partitionTriangles)
+	{
+		partitionIBO();
+		appendLods();
+	}
+	else
+	{
+		for (size_t i = 0; i < meshes.size(); ++i)
+		{
+			if (meshes[i]->positions.empty() || meshes[i]->indices.empty())
+			{
+				continue;
+			}
+
+			IndexRange range;
+			range.mesh = (uint32_t)i;
+			range.first = d_indexInput.host.size();
+			range.count = meshes[i]->indices.size();
+			d_indexInput.host.insert(d_indexInput.host.end(), meshes[i]->indices.begin(), meshes[i]->indices.end());
+			d_indexInput.ranges.push_back(range);
+		}
+
+		appendLods();
+	}
+
+	// bounds of the triangles of every range, vertices are already transformed
+	util::Parallel::forEach(d_indexInput.ranges.size(), [&](size_t i) {
+		auto& range = d_indexInput.ranges[i];
+		const auto& positions = meshes[range.mesh]->positions;
+
+		range.min = glm::vec3(std::numeric_limits<float>::max());
+		range.max = glm::vec3(std::numeric_limits<float>::lowest());
+		for (size_t ii = range.first; ii < range.first + range.count; ++ii)
+		{
+			range.min = glm::min(range.min, positions[d_indexInput.host[ii]]);
+			range.max = glm::max(range.max, positions[d_indexInput.host[ii]]);
+		}
+	}, 16);
+
+	// a chain replaces every range of its mesh, its bounds are the union of them
+	for (auto& chain : d_indexInput.lods)
+	{
+		chain.min = glm::vec3(std::numeric_limits<float>::max());
+		chain.max = glm::vec3(std::numeric_limits<float>::lowest());
+	}
+	for (const auto& range : d_indexInput.ranges)
+	{
+		if (range.mesh < d_indexInput.lods.size())
+		{
+			d_indexInput.lods[range.mesh].min = glm::min(d_indexInput.lods[range.mesh].min, range.min);
+			d_indexInput.lods[range.mesh].max = glm::max(d_indexInput.lods[range.mesh].max, range.max);
+		}
+	}
+
+	// indices are relative to the vertex range of their mesh, small meshes fit 16 bits
+	std::vector<uint16_t> narrow;
+	if (mesh::Utility::narrowIndices(d_indexInput.host, narrow))
+	{
+		d_indexInput.type = vk::IndexType::eUint16;
+		d_indexInput.ibo = d_vkCtx->createIndexBufferObject(narrow);
+	}
+	else
+	{
+		d_indexInput.type = vk::IndexType::eUint32;
+		d_indexInput.ibo = d_vkCtx->createIndexBufferObject(d_indexInput.host);
+	}
+}
+
+void StaticModelRenderer::appendLods()
+{
+	auto& meshes = d_input.smodel->meshes();
 
-	//d_tree = std::make_unique<octree::DrawMeshOctree>(glm::vec3{ -1000.0f, -1000.0f, -1000.0f }, 2000.0f, 10);
-
-	//for (size_t i = 0; i < d_input.smodel->meshes().size(); ++i)
-	//{
-	//	auto& mesh = d_input.smodel->meshes()[i];
-	//	auto& vertices = mesh->positions;
-	//	auto& indices = mesh->indices;
-
-	//	for (size_t ii = 0; ii < indices.size(); ii += 3)
-	//	{
-	//		auto pt = vertices[indices[ii]];
-
-	//		octree::DrawMeshOctree::ErrorCode err;
-	//		auto& data = d_tree->push(pt, err);
-
-	//		data.resize(d_input.smodel->meshes().size());
-	//		data[i].vbo = d_vertexInput.vbo;
-	//		data[i].vbo_offset = d_vertexInput.offsets[i];
-
-	//		if (err == 0)
-	//		{
-	//			data[i].ibo_host.push_back(indices[ii]);
-	//			data[i].ibo_host.push_back(indices[ii + 1]);
-	//			data[i].ibo_host.push_back(indices[ii + 2]);
-	//		}
-	//	}
-	//}
-
-	//d_tree->linearProcess([this](octree::DrawMeshNode& node) {
-	//	assert(node.childrenFlags == 0);
-	//	//for (auto& elem : *node.data)
-	//	//{
-	//	//	elem.ibo = d_vkCtx->createIndexBufferObject(elem.ibo_host);
-	//	//	elem.draw_index_count = elem.ibo_host.size();
-	//	//	elem.ibo_host.clear();
-	//	//}
-	//}, true);
+	// errors are in model units, the transform scales them like the vertices
+	const glm::mat3 linear(d_input.transform);
+	const float scale = std::max(glm::length(linear[0]), std::max(glm::length(linear[1]), glm::length(linear[2])));
+
+	d_indexInput.lods.resize(meshes.size());
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		for (const auto& lod : d_input.smodel->lods(i))
+		{
+			LodRange level;
+			level.first = d_indexInput.host.size();
+			level.count = lod.indices.size();
+			level.error = lod.error * scale;
+			d_indexInput.host.insert(d_indexInput.host.end(), lod.indices.begin(), lod.indices.end());
+			d_indexInput.lods[i].levels.push_back(level);
+		}
+	}
+}
 
+int32_t StaticModelRenderer::pickLod(uint32_t mesh, const glm::vec3& eye, float pixel_scale) const
+{
+	const auto& chain = d_indexInput.lods[mesh];
+	const float distance = glm::length(glm::max(glm::max(chain.min - eye, eye - chain.max), glm::vec3(0.0f)));
+
+	int32_t picked = LOD_FULL;
+	for (size_t i = 0; i < chain.levels.size(); ++i)
+	{
+		if (chain.levels[i].error * pixel_scale > d_lodPixelError * distance)
+		{
+			break;
+		}
+		picked = (int32_t)i;
+	}
+	return picked;
+}
+
+void StaticModelRenderer::partitionIBO()
+{
+	auto& meshes = d_input.smodel->meshes();
+
+	// triangles are numbered mesh after mesh, first_triangle[i] is the first one of mesh i
+	std::vector<uint32_t> first_triangle(meshes.size() + 1, 0);
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		const bool valid = !meshes[i]->positions.empty();
+		first_triangle[i + 1] = first_triangle[i] + (valid ? (uint32_t)(meshes[i]->indices.size() / 3) : 0);
+	}
+
+	const size_t triangle_count = first_triangle.back();
+	if (triangle_count == 0)
+	{
+		return;
+	}
+
+	std::vector<glm::vec3> centroids(triangle_count);
+	std::vector<uint32_t> ids(triangle_count);
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		const auto& mesh = *meshes[i];
+		util::Parallel::forEach(first_triangle[i + 1] - first_triangle[i], [&](size_t tri) {
+			const glm::vec3& a = mesh.positions[mesh.indices[tri * 3 + 0]];
+			const glm::vec3& b = mesh.positions[mesh.indices[tri * 3 + 1]];
+			const glm::vec3& c = mesh.positions[mesh.indices[tri * 3 + 2]];
+			centroids[first_triangle[i] + tri] = (a + b + c) / 3.0f;
+			ids[first_triangle[i] + tri] = first_triangle[i] + (uint32_t)tri;
+		});
+	}
+
+	glm::vec3 scene_min(std::numeric_limits<float>::max());
+	glm::vec3 scene_max(std::numeric_limits<float>::lowest());
+	for (const auto& pt : centroids)
+	{
+		scene_min = glm::min(scene_min, pt);
+		scene_max = glm::max(scene_max, pt);
+	}
+
+	// surfaces fill about 4^depth leaves, pick the depth giving leaves of about d_partitionTriangles
+	size_t depth = 1;
+	while (depth < 8 && (size_t(1) << (2 * depth)) * d_partitionTriangles < triangle_count)
+	{
+		++depth;
+	}
+
+	const glm::vec3 extent = scene_max - scene_min;
+	const float side = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f)) * 1.01f;
+	octree::LinearOctree<uint32_t> buckets(scene_min - glm::vec3(side * 0.005f), side, depth);
+	buckets.build(centroids, ids);
+
+	// leaves are visited in Morton order and keep their ids ascending, so the triangles of one mesh
+	// in one leaf are a run and neighbouring leaves end up next to each other in the buffer
+	buckets.traverse([&](const glm::vec3& min, const glm::vec3& max, std::span<uint32_t> data) {
+		for (size_t begin = 0; begin < data.size();)
+		{
+			const uint32_t mesh = (uint32_t)(std::upper_bound(first_triangle.begin(), first_triangle.end(), data[begin]) - first_triangle.begin() - 1);
+			const auto& indices = meshes[mesh]->indices;
+
+			IndexRange range;
+			range.mesh = mesh;
+			range.first = d_indexInput.host.size();
+
+			size_t end = begin;
+			for (; end < data.size() && data[end] < first_triangle[mesh + 1]; ++end)
+			{
+				const size_t tri = data[end] - first_triangle[mesh];
+				d_indexInput.host.insert(d_indexInput.host.end(), indices.begin() + tri * 3, indices.begin() + tri * 3 + 3);
+			}
+
+			range.count = (end - begin) * 3;
+			d_indexInput.ranges.push_back(range);
+			begin = end;
+		}
+		return true;
+	});
+
+	SDL_Log("octree partition: %zu triangles in %zu ranges, depth %zu", triangle_count, d_indexInput.ranges.size(), depth);
+}
+
+void StaticModelRenderer::meshletIBO()
+{
+	auto& meshes = d_input.smodel->meshes();
+
+	std::vector<mesh::MeshletMesh> clusters(meshes.size());
+	util::Parallel::forEach(meshes.size(), [&](size_t i) {
+		if (!meshes[i]->positions.empty() && !meshes[i]->indices.empty())
+		{
+			mesh::Utility::buildMeshlets(*meshes[i], clusters[i]);
+		}
+	}, 1);
+
+	// meshlets keep the triangle order of their mesh, so each one is a range of mesh indices
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		for (const auto& meshlet : clusters[i].meshlets)
+		{
+			IndexRange range;
+			range.mesh = (uint32_t)i;
+			range.first = d_indexInput.host.size();
+			range.count = meshlet.triangle_count * 3;
+			d_indexInput.clusters.push_back({ range.first, meshlet.sphere, meshlet.cone });
+
+			for (size_t ii = 0; ii < range.count; ++ii)
+			{
+				const uint8_t local = clusters[i].triangles[meshlet.triangle_offset + ii];
+				d_indexInput.host.push_back(clusters[i].vertices[meshlet.vertex_offset + local]);
+			}
+			d_indexInput.ranges.push_back(range);
+		}
+	}
+
+	SDL_Log("meshlets: %zu ranges", d_indexInput.ranges.size());
+}
+
+void StaticModelRenderer::sceneCube(glm::vec3& min, float& side) const
+{
+	glm::vec3 max(std::numeric_limits<float>::lowest());
+	min = glm::vec3(std::numeric_limits<float>::max());
+	for (const auto& range : d_indexInput.ranges)
+	{
+		min = glm::min(min, range.min);
+		max = glm::max(max, range.max);
+	}
+
+	// slightly padded so boxes on the max faces are still inside
+	const glm::vec3 extent = max - min;
+	side = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f)) * 1.01f;
+}
+
+bool StaticModelRenderer::mapTree()
+{
+	auto tree = std::make_unique<octree::MappedDrawRecordOctree>(glm::vec3(0.0f), 1.0f, 1);
+	if (!tree->map(d_treeFile))
+	{
+		return false;
+	}
+
+	// the file belongs to this model when it covers the same cube and holds exactly the ranges just built,
+	// which are sorted by their first index
+	glm::vec3 scene_min, tree_min, tree_max;
+	float side;
+	sceneCube(scene_min, side);
+	tree->bounds(tree_min, tree_max);
+
+	std::vector<octree::DrawRecord> records;
+	records.reserve(d_indexInput.ranges.size());
+	tree->linearProcess([&](octree::LOctantNode<octree::DrawRecord>& node) {
+		const auto data = tree->node_data(&node);
+		records.insert(records.end(), data.begin(), data.end());
+	}, true);
+
+	std::sort(records.begin(), records.end(), [](const octree::DrawRecord& a, const octree::DrawRecord& b) {
+		return a.first_index < b.first_index;
+	});
+
+	const auto& ranges = d_indexInput.ranges;
+	bool match = tree_min == scene_min && glm::length(tree_max - (scene_min + glm::vec3(side))) <= side * 1e-5f &&
+		records.size() == ranges.size();
+	for (size_t i = 0; match && i < ranges.size(); ++i)
+	{
+		match = records[i] == octree::DrawRecord{ ranges[i].mesh, INDEX_BUFFER_MAIN, (uint32_t)ranges[i].first, (uint32_t)ranges[i].count };
+	}
+
+	if (!match)
+	{
+		SDL_Log("octree file %s was saved for other ranges, rebuilding it", d_treeFile.c_str());
+		return false;
+	}
+
+	SDL_Log("octree mapped from %s, %zu ranges", d_treeFile.c_str(), records.size());
+	d_mappedTree = std::move(tree);
 	return true;
 }
 
-void StaticModelRenderer::buildIBO()
+void StaticModelRenderer::buildTree()
+{
+	glm::vec3 scene_min;
+	float side;
+	sceneCube(scene_min, side);
+	d_tree = std::make_unique<octree::DrawRecordOctree>(scene_min, side, 8, 0, 2.0f);
+
+	for (const auto& range : d_indexInput.ranges)
+	{
+		const octree::DrawRecord data{ range.mesh, INDEX_BUFFER_MAIN, (uint32_t)range.first, (uint32_t)range.count };
+
+		octree::DrawRecordOctree::ErrorCode err;
+		if (!d_tree->push(range.min, range.max, data, err))
+		{
+			// outside the root or too large for a loose node, drawn every frame instead of never
+			SDL_Log("octree rejected range %zu of mesh %u (error %d), drawing it unculled", range.first, range.mesh, (int)err);
+			d_unculled.push_back(data);
+		}
+	}
+}
+
+template <class Tree>
+void StaticModelRenderer::buildProxies(Tree& tree)
 {
+	// cells per side of a node, a proxy keeps at most about PROXY_GRID^2 triangles per mesh
+	const float PROXY_GRID = 32.0f;
+	// proxies saving less than half of the indices are not worth an extra lookup
+	const float PROXY_MAX_RATIO = 0.5f;
+
+	// a proxy merges many meshlets into geometry without a sphere or cone, drawing it would bypass cluster culling
+	if (d_meshletCulling)
+	{
+		return;
+	}
+
 	auto& meshes = d_input.smodel->meshes();
-	for (int i = 0; i < meshes.size(); ++i)
+
+	// what a node hands to its parent for one mesh: its simplified indices, or the pieces it got when they did not simplify
+	struct ProxyMesh
+	{
+		struct Piece
+		{
+			const octree::DrawRecord* draw = nullptr; // a full range of the main buffer
+			ProxyMesh* proxy = nullptr;               // or the simplified output of a node below
+		};
+
+		uint32_t mesh = 0;
+		std::vector<Piece> pieces;
+		std::vector<uint32_t> indices;
+		bool simplified = false;
+		float error = 0.0f;                 // farthest a vertex moved from the full geometry
+		uint32_t offset = UINT32_MAX;       // first index in the proxy buffer once uploaded
+	};
+
+	struct Proxy
+	{
+		octree::LOctantNode<octree::DrawRecord>* node = nullptr;
+		std::vector<size_t> children;
+		std::vector<ProxyMesh> meshes; // sorted by mesh
+		size_t full_count = 0;         // indices of every full range below the node
+		float error = 0.0f;
+		bool keep = false;
+	};
+
+	std::vector<Proxy> proxies;
+	std::vector<std::vector<size_t>> levels;
+	std::unordered_map<const octree::LOctantNode<octree::DrawRecord>*, size_t> index_of;
+	tree.linearProcess([&](octree::LOctantNode<octree::DrawRecord>& node) {
+		const size_t depth = tree.node_depth(&node);
+		if (levels.size() <= depth)
+		{
+			levels.resize(depth + 1);
+		}
+		levels[depth].push_back(proxies.size());
+		index_of[&node] = proxies.size();
+
+		Proxy proxy;
+		proxy.node = &node;
+		proxies.push_back(std::move(proxy));
+	}, false);
+
+	for (auto& proxy : proxies)
+	{
+		if (auto* parent = tree.parent_node(proxy.node))
+		{
+			proxies[index_of[parent]].children.push_back(&proxy - proxies.data());
+		}
+	}
+
+	// deepest nodes first, a node only clusters its own ranges and the already reduced output of its children,
+	// so the work per node stays bounded by the grid instead of growing with the geometry below it
+	for (size_t depth = levels.size(); depth-- > 0;)
+	{
+		const auto& level = levels[depth];
+		util::Parallel::forEach(level.size(), [&](size_t l) {
+			auto& proxy = proxies[level[l]];
+
+			std::vector<std::pair<uint32_t, typename ProxyMesh::Piece>> inputs;
+			for (const auto& elem : tree.node_data(proxy.node))
+			{
+				inputs.push_back({ elem.mesh_index, { &elem, nullptr } });
+				proxy.full_count += elem.index_count;
+			}
+			for (size_t child : proxy.children)
+			{
+				auto& below = proxies[child];
+				proxy.full_count += below.full_count;
+				for (auto& out : below.meshes)
+				{
+					if (out.simplified)
+					{
+						inputs.push_back({ out.mesh, { nullptr, &out } });
+						continue;
+					}
+					for (const auto& piece : out.pieces)
+					{
+						inputs.push_back({ out.mesh, piece });
+					}
+				}
+			}
+			std::stable_sort(inputs.begin(), inputs.end(), [](const auto& a, const auto& b) {
+				return a.first < b.first;
+			});
+
+			glm::vec3 min, max, loose_min, loose_max;
+			tree.node_bounds(proxy.node, min, max);
+			tree.loose_bounds(min, max, loose_min, loose_max);
+			const float cell_size = (loose_max.x - loose_min.x) / PROXY_GRID;
+
+			size_t proxy_count = 0;
+			std::vector<uint32_t> source;
+			for (size_t begin = 0; begin < inputs.size();)
+			{
+				ProxyMesh out;
+				out.mesh = inputs[begin].first;
+
+				source.clear();
+				float input_error = 0.0f;
+				size_t end = begin;
+				for (; end < inputs.size() && inputs[end].first == out.mesh; ++end)
+				{
+					const auto& piece = inputs[end].second;
+					out.pieces.push_back(piece);
+					if (piece.draw)
+					{
+						auto first = d_indexInput.host.begin() + piece.draw->first_index;
+						source.insert(source.end(), first, first + piece.draw->index_count);
+					}
+					else
+					{
+						source.insert(source.end(), piece.proxy->indices.begin(), piece.proxy->indices.end());
+						input_error = std::max(input_error, piece.proxy->error);
+					}
+				}
+				begin = end;
+
+				float error = 0.0f;
+				if (mesh::Utility::clusterVertices(meshes[out.mesh]->positions, source, loose_min, cell_size, out.indices, error) &&
+					out.indices.size() <= source.size() * PROXY_MAX_RATIO)
+				{
+					out.pieces.clear();
+					out.simplified = true;
+					out.error = input_error + error;
+					proxy_count += out.indices.size();
+				}
+				else
+				{
+					std::vector<uint32_t>().swap(out.indices);
+					out.error = input_error;
+					proxy_count += source.size();
+				}
+
+				proxy.error = std::max(proxy.error, out.error);
+				proxy.meshes.push_back(std::move(out));
+			}
+
+			proxy.keep = proxy.full_count && proxy_count <= proxy.full_count * PROXY_MAX_RATIO;
+		}, 1);
+	}
+
+	// simplified output referenced by a kept proxy goes to one more shared buffer, once even when several nodes use it
+	std::vector<uint32_t> host;
+	std::vector<std::vector<octree::DrawRecord>> elements(proxies.size());
+	size_t proxy_nodes = 0;
+
+	auto proxy_record = [&](ProxyMesh& out) {
+		if (out.offset == UINT32_MAX)
+		{
+			out.offset = (uint32_t)host.size();
+			host.insert(host.end(), out.indices.begin(), out.indices.end());
+		}
+		return octree::DrawRecord{ out.mesh, INDEX_BUFFER_PROXY, out.offset, (uint32_t)out.indices.size() };
+	};
+
+	for (size_t i = 0; i < proxies.size(); ++i)
+	{
+		if (!proxies[i].keep)
+		{
+			continue;
+		}
+
+		for (auto& out : proxies[i].meshes)
+		{
+			if (out.simplified)
+			{
+				if (!out.indices.empty()) // otherwise collapsed below a cell
+				{
+					elements[i].push_back(proxy_record(out));
+				}
+				continue;
+			}
+
+			for (const auto& piece : out.pieces)
+			{
+				if (piece.draw)
+				{
+					elements[i].push_back(*piece.draw);
+				}
+				else if (!piece.proxy->indices.empty())
+				{
+					elements[i].push_back(proxy_record(*piece.proxy));
+				}
+			}
+		}
+
+		++proxy_nodes;
+	}
+
+	if (!host.empty())
 	{
-		d_indexInput.index_count.push_back(meshes[i]->indices.size());
-		d_indexInput.ibos.push_back(d_vkCtx->createIndexBufferObject(meshes[i]->indices));
+		// proxies index a subset of the same vertices, they always fit the type of the full buffer
+		std::vector<uint16_t> narrow;
+		if (d_indexInput.type == vk::IndexType::eUint16)
+		{
+			mesh::Utility::narrowIndices(host, narrow);
+			d_indexInput.proxy_ibo = d_vkCtx->createIndexBufferObject(narrow);
+		}
+		else
+		{
+			d_indexInput.proxy_ibo = d_vkCtx->createIndexBufferObject(host);
+		}
 	}
+
+	for (size_t i = 0; i < proxies.size(); ++i)
+	{
+		if (!proxies[i].keep)
+		{
+			continue;
+		}
+
+		tree.set_proxy(proxies[i].node, elements[i], proxies[i].error);
+	}
+
+	SDL_Log("octree lod: %zu of %zu nodes got a proxy, %zu proxy indices", proxy_nodes, proxies.size(), host.size());
 }
 
 void StaticModelRenderer::buildUBO()
@@ -275,16 +935,16 @@ void StaticModelRenderer::buildUBO()
 		1, &d_ubo.descriptorSetLayout
 		))[0];
 
-	//vk::PushConstantRange pushConstantRange(
-	//	vk::ShaderStageFlagBits::eFragment,
-	//	0, sizeof(float)
-	//);
+	vk::PushConstantRange pushConstantRange(
+		vk::ShaderStageFlagBits::eVertex,
+		0, sizeof(PushConstants)
+	);
 
 	d_ubo.pipelineLayout =
 		d_vkCtx->vkDevice().createPipelineLayout(vk::PipelineLayoutCreateInfo(
 		vk::PipelineLayoutCreateFlags(),
 		1, &d_ubo.descriptorSetLayout,
-		0, nullptr
+		1, &pushConstantRange
 		));
 
 	d_ubo.mvp_buffer_info.buffer = d_ubo.mvp_buffer->buffer;
@@ -312,11 +972,20 @@ void StaticModelRenderer::buildPipeline()
 		app::SystemMgr::instance().settings().shader_dir + "model.frag.spv"
 	);
 
+	// the vertex shader decodes normals of the compressed format
+	d_pipeline.octahedralNormals = d_compressVertices ? VK_TRUE : VK_FALSE;
+	d_pipeline.specializationEntry = vk::SpecializationMapEntry(0, 0, sizeof(VkBool32));
+	d_pipeline.specialization = vk::SpecializationInfo(
+		1, &d_pipeline.specializationEntry,
+		sizeof(VkBool32), &d_pipeline.octahedralNormals
+	);
+
 	d_pipeline.shaderCreateInfos = {
 		vk::PipelineShaderStageCreateInfo(
 			vk::PipelineShaderStageCreateFlags(),
 			vk::ShaderStageFlagBits::eVertex,
-			d_pipeline.vs, "main"
+			d_pipeline.vs, "main",
+			&d_pipeline.specialization
 		),
 		vk::PipelineShaderStageCreateInfo(
 			vk::PipelineShaderStageCreateFlags(),
@@ -337,12 +1006,14 @@ void StaticModelRenderer::buildPipeline()
 		1, &d_renderArea
 	);
 
+	// the meshlet normal cones drop back facing clusters, so back faces are culled per triangle as well or the
+	// result would depend on setMeshlets. right handed projection with y flipped in model.vert keeps ccw in front.
 	auto rasterState = vk::PipelineRasterizationStateCreateInfo(
 		vk::PipelineRasterizationStateCreateFlags(),
 		VK_FALSE,
 		VK_FALSE,
 		vk::PolygonMode::eFill,
-		vk::CullModeFlagBits::eNone,
+		d_meshletCulling ? vk::CullModeFlagBits::eBack : vk::CullModeFlagBits::eNone,
 		vk::FrontFace::eCounterClockwise,
 		VK_FALSE,
 		0,
@@ -4,6 +4,7 @@
 #include "../camera/free_camera.h"
 #include "../mesh/basic_mesh.h"
 #include "../mesh/static_model.h"
+#include "../mesh/vertex_layout.h"
 #include "../octree/linear_octree.h"
 
 #include <string>
@@ -21,6 +22,22 @@ public:
 	void setCamera(std::shared_ptr<camera::FreeCamera> cam);
 	void setViewport(int x, int y, int width, int height);
 	void setModel(std::shared_ptr<mesh::StaticModel> model, const glm::mat4& transform = glm::mat4(1.0f));
+	// octree nodes are drawn from their coarse proxy, and meshes from their coarsest StaticModel::lods level,
+	// once its error projects to at most this many pixels. a partitioned mesh picks its level once per frame
+	// from the bounds of all its leaves, a coarse level is drawn once in place of every visible leaf of the mesh.
+	void setLodThreshold(float max_pixel_error);
+	// buckets the triangles of every mesh into octree leaves of about leaf_triangles, one index range per leaf and mesh,
+	// so large meshes are culled piece by piece. 0 draws every mesh as a whole. takes effect on build.
+	void setPartition(size_t leaf_triangles);
+	// uploads CompressedVertexFormat instead of VertexFormat, 16 instead of 40 bytes per vertex. takes effect on build.
+	void setCompression(bool compress_vertices);
+	// splits every mesh into meshlets, one index range each, rejected by their bounding sphere and normal cone
+	// before the draws are recorded, back faces are culled in the pipeline to match.
+	// replaces the leaf partition, octree nodes get no proxies in this mode. takes effect on build.
+	void setMeshlets(bool meshlet_culling);
+	// static scenes: build maps the culling octree from file when it was saved for the same ranges and bounds,
+	// otherwise it builds the tree and saves it there. empty (default) always builds in memory.
+	void setTreeFile(const std::string& file);
 	bool build(bool clearhost = true);
 
 	void render() override;
@@ -45,19 +62,77 @@ private:
 		glm::mat4 proj;
 	}d_mvp;
 
+	// the attributes model.vert reads, nothing else is uploaded
+	using VertexFormat = mesh::VertexLayout<mesh::Attribute::POSITION, mesh::Attribute::NORMAL, mesh::Attribute::COLOR>;
+	// same attributes quantized, positions relative to the bounds of their mesh and octahedral normals
+	using CompressedVertexFormat = mesh::VertexLayout<mesh::Attribute::POSITION_UNORM16, mesh::Attribute::NORMAL_OCT16, mesh::Attribute::COLOR_UNORM8>;
+
+	// per draw push constants, model.vert decodes positions as min + position * extent
+	struct PushConstants
+	{
+		glm::vec4 bounds_min;
+		glm::vec4 bounds_extent;
+	};
+
 	struct BufferData // vbos
 	{
 		std::shared_ptr<vkapi::BufferObject> vbo;
 		std::vector<size_t> offsets;
+		std::vector<mesh::VertexBounds> bounds; // per mesh, identity without compression
 		vk::PipelineVertexInputStateCreateInfo inputState;
 		vk::VertexInputBindingDescription inputBinding;
 		std::vector<vk::VertexInputAttributeDescription> inputAttributes;
 	}d_vertexInput;
 
+	// one contiguous range of a mesh in the shared index buffer and the bounds of its triangles
+	struct IndexRange
+	{
+		uint32_t mesh = 0;
+		size_t first = 0;
+		size_t count = 0;
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	// culling bounds of a meshlet range, looked up by its first index
+	struct ClusterBounds
+	{
+		size_t first = 0;
+		glm::vec4 sphere;
+		glm::vec4 cone;
+	};
+
+	// LODs of a whole mesh draw in the shared index buffer, coarser ones later
+	struct LodRange
+	{
+		size_t first = 0;
+		size_t count = 0;
+		float error = 0.0f; // world units
+	};
+
+	struct LodChain
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		std::vector<LodRange> levels;
+	};
+
+	// DrawRecord::buffer, the index buffer a recorded range lives in
+	enum IndexBuffer : uint32_t
+	{
+		INDEX_BUFFER_MAIN = 0,
+		INDEX_BUFFER_PROXY
+	};
+
 	struct IndexBufferData
 	{
-		std::vector<std::shared_ptr<vkapi::BufferObject>> ibos;
-		std::vector<size_t> index_count;
+		std::shared_ptr<vkapi::BufferObject> ibo;       // every range, mesh after mesh or leaf after leaf
+		std::shared_ptr<vkapi::BufferObject> proxy_ibo; // level of detail proxies
+		std::vector<uint32_t> host;                     // content of ibo, dropped after build
+		std::vector<IndexRange> ranges;
+		vk::IndexType type = vk::IndexType::eUint32;    // of both buffers, 16 bit when every mesh has few enough vertices
+		std::vector<LodChain> lods;                     // per mesh from StaticModel::lods, not for meshlet ranges
+		std::vector<ClusterBounds> clusters;            // sorted by first, only for meshlet ranges
 	}d_indexInput;
 
 	struct UBO // unifroms
@@ -84,14 +159,51 @@ private:
 		vk::ShaderModule vs;
 		vk::ShaderModule fs;
 		std::vector<vk::PipelineShaderStageCreateInfo> shaderCreateInfos;
+		// model.vert constant_id 0, octahedral normals
+		VkBool32 octahedralNormals = VK_FALSE;
+		vk::SpecializationMapEntry specializationEntry;
+		vk::SpecializationInfo specialization;
 	}d_pipeline;
 
 
-	std::unique_ptr<octree::DrawMeshOctree> d_tree;
+	// loose octree over the mesh bounds, culled against the camera every frame.
+	// one of the two is set, d_mappedTree when it was loaded from d_treeFile.
+	std::unique_ptr<octree::DrawRecordOctree> d_tree;
+	std::unique_ptr<octree::MappedDrawRecordOctree> d_mappedTree;
+	std::string d_treeFile;
+	std::vector<std::span<octree::DrawRecord>> d_visible;
+	std::vector<octree::DrawRecord> d_unculled; // ranges the tree rejected, drawn every frame
+	// per mesh during render: index of the lod level picked for this frame or one of the values below
+	std::vector<int32_t> d_meshLod;
+	enum : int32_t
+	{
+		LOD_FULL = -1,     // every visible range of the mesh is drawn
+		LOD_UNPICKED = -2, // no range of the mesh was visible yet
+		LOD_DRAWN = -3     // the picked level was drawn, the other ranges of the mesh are skipped
+	};
+	float d_lodPixelError = 1.0f;
+	size_t d_partitionTriangles = 0;
+	bool d_compressVertices = false;
+	bool d_meshletCulling = false;
 
 	// HELPERS
+	// meshlet ranges against their sphere and normal cone, every other draw passes
+	bool clusterVisible(const octree::DrawRecord& elem, const glm::vec3& eye, const camera::Frustum& frustum) const;
 	bool buildVBO();
+	template <class Format>
+	bool interleaveVBO();
 	void buildIBO();
+	void appendLods();
+	// coarsest level of the mesh whose error stays below the threshold at the distance of its bounds, LOD_FULL if none
+	int32_t pickLod(uint32_t mesh, const glm::vec3& eye, float pixel_scale) const;
+	void partitionIBO();
+	void meshletIBO();
+	// padded cube around every range, the root of the tree
+	void sceneCube(glm::vec3& min, float& side) const;
+	bool mapTree();
+	void buildTree();
+	template <class Tree>
+	void buildProxies(Tree& tree);
 	void buildUBO();
 	void buildPipeline();
 };
@@ -0,0 +1,123 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace util
+{
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string& file)
+{
+	close();
+
+	HANDLE handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(handle);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(handle);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(handle);
+		return false;
+	}
+
+	d_file = handle;
+	d_mapping = mapping;
+	d_data = static_cast<uint8_t*>(view);
+	d_size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (d_data)
+	{
+		UnmapViewOfFile(d_data);
+		CloseHandle(d_mapping);
+		CloseHandle(d_file);
+	}
+
+	d_data = nullptr;
+	d_size = 0;
+	d_file = nullptr;
+	d_mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& file)
+{
+	close();
+
+	const int fd = ::open(file.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping keeps the file referenced
+
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+
+	d_data = static_cast<uint8_t*>(view);
+	d_size = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (d_data)
+	{
+		munmap(d_data, d_size);
+	}
+
+	d_data = nullptr;
+	d_size = 0;
+}
+
+#endif
+
+} // end namespace util
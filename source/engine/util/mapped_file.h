@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace util
+{
+
+// read mapping of a whole file. pages are mapped copy on write: they are shared with the
+// file cache until written to, and writes never reach the file.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	void operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& file);
+	void close();
+
+	uint8_t* data() const { return d_data; }
+	size_t size() const { return d_size; }
+	bool is_open() const { return d_data != nullptr; }
+
+private:
+	uint8_t* d_data = nullptr;
+	size_t d_size = 0;
+#if defined(_WIN32)
+	void* d_file = nullptr;
+	void* d_mapping = nullptr;
+#endif
+};
+
+} // end namespace util
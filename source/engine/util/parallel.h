@@ -0,0 +1,55 @@
+#pragma once
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+
+class Parallel
+{
+public:
+	// number of worker chunks a range of count elements is split into
+	static size_t chunkCount(size_t count, size_t min_chunk_size = 4096)
+	{
+		const size_t workers = std::max<size_t>(1, std::thread::hardware_concurrency());
+		const size_t chunks = (count + min_chunk_size - 1) / std::max<size_t>(1, min_chunk_size);
+		return std::max<size_t>(1, std::min(workers, chunks));
+	}
+
+	// calls fn(chunk_index, begin, end) for every chunk of [0, count), chunks run concurrently
+	template <class Fn>
+	static void forEachChunk(size_t count, size_t chunks, Fn&& fn)
+	{
+		if (chunks <= 1)
+		{
+			fn(size_t(0), size_t(0), count);
+			return;
+		}
+
+		std::vector<size_t> ids(chunks);
+		std::iota(ids.begin(), ids.end(), size_t(0));
+
+		std::for_each(std::execution::par, ids.begin(), ids.end(), [&](size_t chunk) {
+			const size_t begin = count * chunk / chunks;
+			const size_t end = count * (chunk + 1) / chunks;
+			fn(chunk, begin, end);
+		});
+	}
+
+	// calls fn(i) for every i in [0, count), concurrently
+	template <class Fn>
+	static void forEach(size_t count, Fn&& fn, size_t min_chunk_size = 4096)
+	{
+		forEachChunk(count, chunkCount(count, min_chunk_size), [&](size_t, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				fn(i);
+			}
+		});
+	}
+};
+
+} // end namespace util
@@ -0,0 +1,337 @@
+#include "octree_benchmark.h"
+#include "../engine/mesh/static_model.h"
+#include "../engine/camera/free_camera.h"
+#include <SDL2/SDL.h>
+
+#include <chrono>
+#include <limits>
+#include <random>
+
+namespace program
+{
+
+namespace
+{
+
+using Clock = std::chrono::high_resolution_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // end anonymous namespace
+
+OctreeBenchmark::OctreeBenchmark()
+{
+}
+
+OctreeBenchmark::OctreeBenchmark(int argc, const char** argv)
+{
+	if (argc > 1)
+	{
+		d_pointCount = std::stoul(argv[1]);
+	}
+
+	if (argc > 2)
+	{
+		d_maxDepth = std::stoul(argv[2]);
+	}
+
+	if (argc > 3)
+	{
+		d_modelPath = argv[3];
+	}
+}
+
+OctreeBenchmark::~OctreeBenchmark()
+{
+}
+
+int OctreeBenchmark::exec()
+{
+	SDL_Log("octree benchmark: %zu points, max depth %zu, %zu culls, %zu rays", d_pointCount, d_maxDepth, d_cullCount, d_rayCount);
+
+	generateUniform(1337);
+	runDistribution("uniform");
+
+	generateClustered(1337);
+	runDistribution("clustered");
+
+	if (generateModelSurface(1337))
+	{
+		runDistribution("model");
+	}
+	else
+	{
+		SDL_Log("skipping model surface samples, no triangles in %s", d_modelPath.c_str());
+	}
+
+	return 0;
+}
+
+void OctreeBenchmark::generateUniform(unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> dist(-1000.0f, 1000.0f);
+
+	d_points.resize(d_pointCount);
+	for (auto& pt : d_points)
+	{
+		pt = glm::vec3(dist(rng), dist(rng), dist(rng));
+	}
+
+	fitBounds();
+}
+
+void OctreeBenchmark::generateClustered(unsigned seed)
+{
+	// a few dense gaussian blobs of different sizes, the worst case for a fixed depth grid
+	const size_t CLUSTERS = 32;
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> center(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> spread(5.0f, 100.0f);
+
+	std::vector<glm::vec3> centers(CLUSTERS);
+	std::vector<float> spreads(CLUSTERS);
+	for (size_t i = 0; i < CLUSTERS; ++i)
+	{
+		centers[i] = glm::vec3(center(rng), center(rng), center(rng));
+		spreads[i] = spread(rng);
+	}
+
+	std::uniform_int_distribution<size_t> pick(0, CLUSTERS - 1);
+	std::normal_distribution<float> offset(0.0f, 1.0f);
+
+	d_points.resize(d_pointCount);
+	for (auto& pt : d_points)
+	{
+		const size_t c = pick(rng);
+		pt = centers[c] + glm::vec3(offset(rng), offset(rng), offset(rng)) * spreads[c];
+	}
+
+	fitBounds();
+}
+
+bool OctreeBenchmark::generateModelSurface(unsigned seed)
+{
+	auto model = std::make_shared<mesh::StaticModel>(d_modelPath);
+
+	// triangles picked by area, then a uniform point inside the picked triangle
+	std::vector<const glm::vec3*> corners;
+	std::vector<double> area_sum;
+	double total_area = 0.0;
+
+	for (const auto& mesh : model->meshes())
+	{
+		for (size_t i = 0; i + 2 < mesh->indices.size(); i += 3)
+		{
+			const glm::vec3* a = &mesh->positions[mesh->indices[i + 0]];
+			const glm::vec3* b = &mesh->positions[mesh->indices[i + 1]];
+			const glm::vec3* c = &mesh->positions[mesh->indices[i + 2]];
+
+			total_area += 0.5 * glm::length(glm::cross(*b - *a, *c - *a));
+			area_sum.push_back(total_area);
+			corners.push_back(a);
+			corners.push_back(b);
+			corners.push_back(c);
+		}
+	}
+
+	if (area_sum.empty() || total_area <= 0.0)
+	{
+		return false;
+	}
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> pick(0.0, total_area);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	d_points.resize(d_pointCount);
+	for (auto& pt : d_points)
+	{
+		const size_t tri = std::min((size_t)(std::upper_bound(area_sum.begin(), area_sum.end(), pick(rng)) - area_sum.begin()), area_sum.size() - 1);
+		float u = unit(rng), v = unit(rng);
+		if (u + v > 1.0f)
+		{
+			u = 1.0f - u;
+			v = 1.0f - v;
+		}
+
+		const glm::vec3& a = *corners[tri * 3 + 0];
+		const glm::vec3& b = *corners[tri * 3 + 1];
+		const glm::vec3& c = *corners[tri * 3 + 2];
+		pt = a + (b - a) * u + (c - a) * v;
+	}
+
+	fitBounds();
+	return true;
+}
+
+void OctreeBenchmark::fitBounds()
+{
+	glm::vec3 min(std::numeric_limits<float>::max());
+	glm::vec3 max(-std::numeric_limits<float>::max());
+	for (const auto& pt : d_points)
+	{
+		min = glm::min(min, pt);
+		max = glm::max(max, pt);
+	}
+
+	// cube around the points, padded so the points on the max faces are inside
+	const glm::vec3 extent = max - min;
+	d_sideLength = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f)) * 1.01f;
+	d_min = min - glm::vec3(d_sideLength * 0.005f);
+}
+
+void OctreeBenchmark::runDistribution(const std::string& name)
+{
+	SDL_Log("--- %s, cube side %.1f", name.c_str(), d_sideLength);
+	runStorage<octree::MapNodeStorage<octree::LOctantNode<uint32_t>>>(name + "/unordered_map");
+	runStorage<octree::FlatNodeStorage<octree::LOctantNode<uint32_t>>>(name + "/flat");
+}
+
+template <class Storage>
+void OctreeBenchmark::runStorage(const std::string& name)
+{
+	using Tree = octree::LinearOctree<uint32_t, uint32_t, Storage>;
+	Tree tree(d_min, d_sideLength, d_maxDepth);
+
+	auto start = Clock::now();
+	for (size_t i = 0; i < d_points.size(); ++i)
+	{
+		typename Tree::ErrorCode err;
+		tree.push(d_points[i], (uint32_t)i, err);
+	}
+	const double pushMs = elapsedMs(start);
+
+	// bulk build of the same points
+	std::vector<uint32_t> ids(d_points.size());
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		ids[i] = (uint32_t)i;
+	}
+
+	Tree built(d_min, d_sideLength, d_maxDepth);
+	start = Clock::now();
+	built.build(d_points, ids);
+	const double buildMs = elapsedMs(start);
+
+	size_t visited = 0;
+	start = Clock::now();
+	built.traverse([&visited](const glm::vec3& min, const glm::vec3& max, std::span<uint32_t> data) {
+		visited += data.size();
+		return true;
+	});
+	const double traverseMs = elapsedMs(start);
+
+	size_t processed = 0;
+	start = Clock::now();
+	built.linearProcess([&processed](octree::LOctantNode<uint32_t>& node) {
+		processed += node.count;
+	}, true);
+	const double linearMs = elapsedMs(start);
+
+	// walk every leaf up to the root through parent_node, one lookup per level
+	size_t lookups = 0;
+	std::vector<octree::LOctantNode<uint32_t>*> leaves;
+	built.linearProcess([&leaves](octree::LOctantNode<uint32_t>& node) {
+		leaves.push_back(&node);
+	}, true);
+
+	start = Clock::now();
+	for (auto* node : leaves)
+	{
+		for (auto* parent = built.parent_node(node); parent; parent = built.parent_node(parent))
+		{
+			++lookups;
+		}
+	}
+	const double lookupMs = elapsedMs(start);
+
+	// camera in the middle of the cube turning around the up axis
+	const glm::vec3 center = d_min + glm::vec3(d_sideLength * 0.5f);
+	camera::FreeCamera camera(center, 1280, 720, 60.0f, glm::vec2(0.1f, d_sideLength));
+	std::vector<std::span<uint32_t>> visible;
+	size_t culled = 0;
+
+	start = Clock::now();
+	for (size_t i = 0; i < d_cullCount; ++i)
+	{
+		camera.yaw(360.0f / (float)d_cullCount);
+		built.cullFrustum(camera, visible);
+		for (auto leaf : visible)
+		{
+			culled += leaf.size();
+		}
+	}
+	const double cullMs = elapsedMs(start);
+
+	// rays from a sphere around the cube to random points inside, elements are spheres of half a cell
+	const float radius = d_sideLength / (float)(1u << d_maxDepth) * 0.5f;
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	size_t hits = 0;
+
+	start = Clock::now();
+	for (size_t i = 0; i < d_rayCount; ++i)
+	{
+		const glm::vec3 origin = center + glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng))) * d_sideLength;
+		const glm::vec3 target = center + glm::vec3(unit(rng), unit(rng), unit(rng)) * (d_sideLength * 0.5f);
+		const glm::vec3 dir = glm::normalize(target - origin);
+
+		float hit_t;
+		hits += built.raycast(origin, dir, 2.0f * d_sideLength, [&](std::span<uint32_t> elements, float& t) {
+			bool hit = false;
+			for (auto id : elements)
+			{
+				const glm::vec3 oc = origin - d_points[id];
+				const float b = glm::dot(oc, dir);
+				const float h = b * b - (glm::dot(oc, oc) - radius * radius);
+				const float enter = -b - std::sqrt(std::max(h, 0.0f));
+				if (h >= 0.0f && enter >= 0.0f && enter < t)
+				{
+					t = enter;
+					hit = true;
+				}
+			}
+			return hit;
+		}, hit_t) ? 1 : 0;
+	}
+	const double rayMs = elapsedMs(start);
+
+	SDL_Log("[%s] push %.2f ms | build %.2f ms", name.c_str(), pushMs, buildMs);
+	SDL_Log("[%s] traverse %.2f ms (%zu elems) | linearProcess %.2f ms (%zu elems) | %zu parent lookups %.2f ms",
+		name.c_str(), traverseMs, visited, linearMs, processed, lookups, lookupMs);
+	SDL_Log("[%s] %zu frustum culls %.2f ms (%zu elems) | %zu raycasts %.2f ms (%zu hits)",
+		name.c_str(), d_cullCount, cullMs, culled, d_rayCount, rayMs, hits);
+	logStats(name + " pushed", tree);
+	logStats(name + " built", built);
+}
+
+template <class Tree>
+void OctreeBenchmark::logStats(const std::string& name, Tree& tree)
+{
+	const auto stats = tree.stats();
+
+	SDL_Log("[%s] %zu nodes, %zu leaves, %zu elems | %.2f MB (nodes %.2f MB, payload %.2f MB, %zu free slots)",
+		name.c_str(), stats.node_count, stats.leaf_count, stats.element_count, stats.bytes / (1024.0 * 1024.0),
+		stats.node_bytes / (1024.0 * 1024.0), stats.payload_bytes / (1024.0 * 1024.0), stats.free_slots);
+
+	std::string occupancy;
+	for (size_t i = 0; i < stats.occupancy.size(); ++i)
+	{
+		occupancy += " " + std::to_string(size_t(1) << i) + "+:" + std::to_string(stats.occupancy[i]);
+	}
+	SDL_Log("[%s] leaf occupancy%s", name.c_str(), occupancy.c_str());
+
+	std::string depths;
+	for (size_t depth = 0; depth < stats.depth_nodes.size(); ++depth)
+	{
+		depths += " " + std::to_string(depth) + ":" + std::to_string(stats.depth_nodes[depth]) + "/" + std::to_string(stats.depth_leaves[depth]);
+	}
+	SDL_Log("[%s] nodes/leaves per depth%s", name.c_str(), depths.c_str());
+}
+
+} // end namespace program
@@ -0,0 +1,56 @@
+#pragma once
+#include "../engine/octree/linear_octree.h"
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace program
+{
+
+// command line benchmark for octree::LinearOctree, no window or vulkan context needed.
+// every point distribution is run on both node storages and reports build, push, traversal,
+// frustum cull, raycast timings and the tree statistics.
+// usage: <exe> [point_count] [max_depth] [model_path]
+class OctreeBenchmark
+{
+public:
+	OctreeBenchmark();
+	OctreeBenchmark(int argc, const char** argv);
+	~OctreeBenchmark();
+
+	OctreeBenchmark(const OctreeBenchmark&) = delete;
+	OctreeBenchmark(OctreeBenchmark&&) = delete;
+	void operator=(const OctreeBenchmark&) = delete;
+	void operator=(OctreeBenchmark&&) = delete;
+
+	int exec();
+
+private:
+	size_t d_pointCount = 1 << 20;
+	size_t d_maxDepth = 10;
+	size_t d_cullCount = 64;
+	size_t d_rayCount = 1 << 14;
+	std::string d_modelPath = "assets/mesh/bedroom/iscv2.obj";
+
+	// bounds of the current distribution, a cube
+	float d_sideLength = 2000.0f;
+	glm::vec3 d_min = glm::vec3(-1000.0f, -1000.0f, -1000.0f);
+	std::vector<glm::vec3> d_points;
+
+	// HELPERS
+	void generateUniform(unsigned seed);
+	void generateClustered(unsigned seed);
+	bool generateModelSurface(unsigned seed);
+	void fitBounds();
+
+	void runDistribution(const std::string& name);
+
+	template <class Storage>
+	void runStorage(const std::string& name);
+
+	template <class Tree>
+	void logStats(const std::string& name, Tree& tree);
+};
+
+} // end namespace program
@@ -41,9 +41,14 @@ bool StaticMeshExample::initialize()
 	d_debugDraw = std::make_unique<dd::VkDDRenderInterface>(d_vkContext);
 
 	d_staticModel = std::make_shared<mesh::StaticModel>("assets/mesh/bedroom/iscv2.obj");
+	d_staticModel->buildLods(4, 0.5f, 0.05f);
 
 	d_renderer = std::make_unique<renderer::StaticModelRenderer>(d_vkContext, d_camera);
 	d_renderer->setModel(d_staticModel, glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0)));
+	d_renderer->setPartition(4096);
+	d_renderer->setTreeFile("assets/mesh/bedroom/iscv2.octree");
+	d_renderer->setLodThreshold(1.0f);
+	d_renderer->setCompression(true);
 	d_renderer->build(true);
 
 	////auto size = sizeof(octree::LOctantNode<uint32_t>);
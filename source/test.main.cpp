@@ -3,6 +3,7 @@
 #include "program/textured_cube_example.h"
 #include "program/skybox_example.h"
 #include "program/static_mesh_example.h"
+#include "program/octree_benchmark.h"
 
 #include "engine/octree/linear_octree.h"
 
@@ -12,5 +13,6 @@ int main(int argc, const char** argv)
 	//return std::make_shared<program::DebugGuiExample>(argc, argv)->exec();
 	//return std::make_shared<program::TexturedCubeExample>(argc, argv)->exec();
 	//return std::make_shared<program::SkyboxExample>(argc, argv)->exec();
+	//return std::make_shared<program::OctreeBenchmark>(argc, argv)->exec();
 	return std::make_shared<program::StaticMeshExample>(argc, argv)->exec();
 }
\ No newline at end of file